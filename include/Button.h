@@ -25,6 +25,10 @@ public:
 
   bool isActive() { return state_ != State::RELEASED; }
 
+  // The next time poll() needs to be called, or UINT64_MAX if it only needs
+  // to be called after an interrupt.
+  uint64_t nextUpdateMillis() { return next_update_time_ms_; }
+
 private:
   gpio_num_t pin_;
   volatile uint64_t next_update_time_ms_ = -1;
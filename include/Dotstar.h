@@ -2,14 +2,32 @@
 
 #include "stdint.h"
 
+#include "driver/spi_master.h"
+#include "freertos/FreeRTOS.h"
+
 class Dotstar {
 public:
   void setPower(bool state);
+  // Queues the color and returns immediately. Frames are only sent when the
+  // color changes, once the LED has settled after power on.
   void setColor(uint8_t color[3]);
 
+  // The next time setColor needs to be called to flush a pending frame, or
+  // UINT64_MAX if nothing is pending.
+  uint64_t nextUpdateMillis();
+
 private:
-  bool state_;
+  bool state_ = false;
   uint8_t color_[3];
+  // The color the LED is showing, only valid while powered
+  uint8_t sent_color_[3];
+  bool sent_ = false;
+  uint64_t ready_time_ms_ = 0;
+
+  spi_device_handle_t spi_ = nullptr;
+  spi_transaction_t transaction_{};
+  bool in_flight_ = false;
 
-  void swspi_out(uint8_t n);
+  void send();
+  void waitForTransaction(TickType_t ticks);
 };
@@ -12,6 +12,9 @@ public:
   void printState();
   float getBatteryVoltage();
   bool isPowered();
+  // The next time isPowered() or printState() may change their output
+  // without a power-sense interrupt.
+  uint64_t nextUpdateMillis();
 
 private:
   uint64_t nextStateReportMillis_;
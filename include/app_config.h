@@ -5,9 +5,34 @@
 #define APP_CONFIG_WIFI_SSID_SIZE 32
 #define APP_CONFIG_WIFI_PSWD_SIZE 64
 
-void config_load(std::vector<LightManager::Action> &actions,
+// Must be called once at startup, before anything else here
+void config_init();
+void config_load(LightManager::Profiles &profiles, uint8_t *active_profile,
                  char wifi_ssid[APP_CONFIG_WIFI_SSID_SIZE],
                  char wifi_pswd[APP_CONFIG_WIFI_PSWD_SIZE]);
+
+// The setters stage changes and return immediately. Staged changes are
+// written together by config_poll once edits stop for a moment, skipping any
+// that match what is already stored.
 void config_set_ssid(const char wifi_ssid[APP_CONFIG_WIFI_SSID_SIZE]);
 void config_set_pswd(const char wifi_pswd[APP_CONFIG_WIFI_PSWD_SIZE]);
-void config_set_actions(std::vector<LightManager::Action> &actions);
+void config_set_profile(uint8_t idx, const LightManager::Profile &profile);
+void config_set_active_profile(uint8_t idx);
+
+// Must be called from the main task. config_poll hands staged changes to the
+// worker once due, by config_next_flush_millis (UINT64_MAX if nothing is
+// staged or a flush is already queued).
+void config_poll();
+uint64_t config_next_flush_millis();
+// Writes staged changes now, waiting for any flush on the worker to finish
+// first. Call before sleeping or restarting.
+void config_flush();
+
+typedef struct {
+  // NVS values written, skipping any that were unchanged
+  uint32_t writes;
+  uint32_t bytes;
+  uint32_t commits;
+} config_stats_t;
+
+config_stats_t config_get_stats();
@@ -1,5 +1,18 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
+// How many characteristics can be registered, which sizes the GATT table
+#ifndef BT_MAX_CHRS
+#define BT_MAX_CHRS 16
+#endif
+// Notifications are sent at most this often, with any requested in between
+// sent together at the end of the interval
+#ifndef BT_NOTIFY_INTERVAL_MS
+#define BT_NOTIFY_INTERVAL_MS 250
+#endif
+
 enum BtOp {
   REQUEST_READ,
   WRITTEN,
@@ -7,10 +20,17 @@ enum BtOp {
 
 struct bt_chr;
 
+// The ATT error for an access_cb to return when a written value is the wrong
+// length, e.g. too long for the device. Values longer than bufferSize get it
+// before access_cb is called.
+#define BT_ERR_INVALID_LENGTH 0x0d
+
 // On read, bytes should be set to the number of bytes available
 // for reading in the buffer.
 // On write, bytes will contain the number of bytes written to the
 // buffer.
+// Values longer than the MTU are read and written with long reads and writes,
+// which the host reassembles, so callbacks always see the whole value.
 typedef int (*bt_access_fn)(size_t *bytes, const bt_chr *chr, BtOp op);
 
 struct bt_chr {
@@ -19,11 +39,35 @@ struct bt_chr {
   size_t bufferSize;
   bool readable;
   bool writable;
+  // Also takes writes without response, which a client can send several of
+  // per connection event. Needs writable.
+  bool writeNoResponse;
+  // Clients can subscribe to notifications or indications, which read the
+  // value through access_cb like any other read
+  bool notifiable;
   bt_access_fn access_cb;
 };
 
+// Identifies a registered characteristic, in registration order
+typedef size_t bt_chr_id;
+
+// Sets up the host and the GATT table, once. Called by the first bt_start.
 void bt_init();
-void bt_register(bt_chr chr);
+// Registrations must all happen before the first bt_start
+bt_chr_id bt_register(bt_chr chr);
+// Advertises, after the controller is enabled and synced with the host
 void bt_start();
+// Stops advertising, closes connections and disables the controller, leaving
+// the host set up
 void bt_stop();
 bool bt_is_enabled();
+
+// Must be called from the main task. bt_notify asks for subscribers to be
+// sent the characteristic's value, and does nothing if there are none.
+// bt_poll sends everything asked for since the last send, once
+// BT_NOTIFY_INTERVAL_MS has passed, so repeated requests in between coalesce
+// into one. It also asks idle connections for longer intervals. It must be
+// called again by bt_next_update_millis (UINT64_MAX if nothing is waiting).
+void bt_notify(bt_chr_id id);
+void bt_poll();
+uint64_t bt_next_update_millis();
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "esp_bit_defs.h"
+#include "stdint.h"
+
+// Reasons for waking the main task. Events posted while the main task is busy
+// are coalesced and delivered together on the next wait.
+#define EVENT_BUTTON BIT0
+#define EVENT_LIGHT BIT1
+#define EVENT_NETWORK BIT2
+#define EVENT_POWER BIT3
+#define EVENT_CONFIG BIT4
+#define EVENT_WORKER BIT5
+
+// Must be called from the task that will wait for events before anything
+// posts to it.
+void events_init();
+void events_post(uint32_t events);
+void events_post_from_isr(uint32_t events);
+// Blocks until an event is posted or deadline_ms (in millis64() time) passes.
+// Returns the events that were posted, or 0 on timeout.
+uint32_t events_wait(uint64_t deadline_ms);
+uint32_t events_wakeup_count();
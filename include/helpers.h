@@ -3,3 +3,7 @@
 #include "stdint.h"
 
 uint64_t millis64();
+
+// Milliseconds since boot that the CPU was not in light sleep
+uint64_t awake_millis64();
+void record_sleep_millis(uint64_t sleep_ms);
@@ -2,18 +2,36 @@
 
 #include "stddef.h"
 #include "stdint.h"
+#include <array>
 
-static uint8_t LIGHT_COLOR_BLUE[3]{0, 0, 255};
-static uint8_t LIGHT_COLOR_OFF[3]{0, 0, 0};
-static uint8_t LIGHT_COLOR_WHITE[3]{60, 48, 38};
-static uint8_t LIGHT_COLOR_RED[3]{255, 25, 20};
-static uint8_t LIGHT_COLOR_GREEN[3]{30, 90, 0};
+// constexpr so they fold into the code using them rather than each
+// translation unit getting its own writable copy.
+constexpr std::array<uint8_t, 3> LIGHT_COLOR_BLUE{0, 0, 255};
+constexpr std::array<uint8_t, 3> LIGHT_COLOR_OFF{0, 0, 0};
+constexpr std::array<uint8_t, 3> LIGHT_COLOR_WHITE{60, 48, 38};
+constexpr std::array<uint8_t, 3> LIGHT_COLOR_RED{255, 25, 20};
+constexpr std::array<uint8_t, 3> LIGHT_COLOR_GREEN{30, 90, 0};
 
 void light_setup();
 
-void light_set_color(uint8_t color[3], size_t fade_ms_per_step);
+void light_set_color(const uint8_t color[3], size_t fade_ms_per_step);
+// The color being faded to, or shown once the fade is done
 void light_get_color(uint8_t *color);
+// The color showing right now, part way through any fade
+void light_get_current_color(uint8_t *color);
+// How far through the fade the light is, from 0 to 255 once it's done
+uint8_t light_fade_progress();
 
-void light_toggle(size_t fade_ms_per_step, uint8_t last_update_color[3]);
+void light_toggle(size_t fade_ms_per_step, const uint8_t last_update_color[3]);
+
+// Fades follow the gamma curve as a few linear segments on the LEDC fade unit,
+// so they continue through light sleep. light_poll starts each segment and
+// must be called again no later than light_next_update_millis.
+void light_poll();
+uint64_t light_next_update_millis();
 
 bool light_is_fading();
+bool light_is_on();
+
+// Holds the LED pins low through deep sleep. light_setup releases them.
+void light_hold_off();
@@ -1,14 +1,74 @@
 #pragma once
 
+#include "stdint.h"
 #include "time.h"
 
+#define NTM_POSIX_TZ_SIZE 64
+
+// How often the cached timezone is looked up again even if we stay on the same
+// network. Can be overridden from build_flags.
+#ifndef NTM_TZ_REFRESH_INTERVAL_S
+#define NTM_TZ_REFRESH_INTERVAL_S (7 * 24 * 60 * 60)
+#endif
+
+// Where the timezone is looked up. It must answer in ip-api.com's CSV format
+// for `fields=status,message,timezone`, i.e. "success,<IANA zone>". Can be
+// overridden from build_flags, e.g. to point at a self-hosted mirror.
+#ifndef NTM_TZ_URL
+#define NTM_TZ_URL "http://ip-api.com/csv?fields=status,message,timezone"
+#endif
+
+// SNTP syncs are spaced out as far as the estimated clock drift allows while
+// keeping the clock within this bound. Can be overridden from build_flags.
+#ifndef NTM_MAX_CLOCK_ERROR_MS
+#define NTM_MAX_CLOCK_ERROR_MS 30000
+#endif
+#define NTM_SYNC_MIN_INTERVAL_S (15 * 60)
+#define NTM_SYNC_MAX_INTERVAL_S (7 * 24 * 60 * 60)
+// A clock set by hand is only set to the minute
+#define NTM_MANUAL_CLOCK_ERROR_MS (60 * 1000)
+// The last known time is kept in RTC memory, which survives every reset but a
+// power on, and copied to NVS at most this often in case RTC memory is lost
+// while the RTC timer isn't, e.g. across a firmware update. Can be overridden
+// from build_flags.
+#ifndef NTM_CLOCK_SAVE_INTERVAL_S
+#define NTM_CLOCK_SAVE_INTERVAL_S (6 * 60 * 60)
+#endif
+
+// Applies the cached timezone, if any, and restores the clock if a reset lost
+// it, so local time is available before WiFi connects.
 void ntm_init();
+// Sets up just enough state to keep time with a known timezone, without
+// bringing up WiFi or NVS. With a NULL `posix_tz` the last one used is
+// restored from RTC memory, if any. ntm_init must still be called before
+// ntm_connect.
+void ntm_init_offline(const char *posix_tz);
 void ntm_connect(const char *network_name, const char *network_pswd);
+// Switches to new credentials. If WiFi is up and they differ from the ones
+// in use, the station reconnects with them without stopping WiFi; otherwise
+// they're kept for the next ntm_connect. Returns whether they differed.
+bool ntm_reconfigure(const char *network_name, const char *network_pswd);
 void ntm_disconnect();
 void ntm_retry();
+// Sets the local time of day, keeping the timezone and, if the clock has ever
+// been set, the date.
 void ntm_set_offline_time(time_t hour, time_t min);
 bool ntm_has_error();
 bool ntm_is_connected();
 bool ntm_is_active();
 bool ntm_poll_clock_updated();
+// How far off the clock could be by now, going by how it was last set and the
+// drift since, or UINT32_MAX if that's unknown.
+uint32_t ntm_clock_error_ms();
+// When the clock will need an SNTP sync to stay within
+// NTM_MAX_CLOCK_ERROR_MS, or 0 if it needs one now because it has never been
+// synced or has no timezone. There's no need to bring WiFi up before then.
+time_t ntm_next_sync_time();
+// Counts SNTP syncs, so callers can tell whether one happened since they last
+// looked.
+uint32_t ntm_sync_count();
+// Whether a timezone lookup is queued or running on the worker. One is started
+// by the first sync after connecting if the cached zone needs refreshing.
+bool ntm_is_fetching_tz();
+bool ntm_get_posix_tz(char posix_tz[NTM_POSIX_TZ_SIZE]);
 bool ntm_get_local_time(struct tm *info);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// Firmware updates over Bluetooth. An image is streamed into the OTA partition
+// that isn't running, through two characteristics:
+//
+// "ota control", written with a command byte:
+//   1 BEGIN, followed by the image size (u32 little endian) and its SHA-256
+//   2 END, once every byte of the image has been sent
+//   3 ABORT
+// and read as the state (see OtaState), bytes received and image size (u32
+// little endian), then the rate the last update was written at in bytes/s.
+//
+// "ota data", written without response in order, each write carrying the
+// next part of the image. Writes are as long as the negotiated MTU allows.
+//
+// The image goes straight to flash as it arrives, never held whole in RAM.
+// Once END has checked the hash and the image, ota_restart_due is set and the
+// next boot runs the new image.
+enum OtaState : uint8_t {
+  OTA_IDLE,
+  OTA_RECEIVING,
+  OTA_VERIFYING,
+  OTA_DONE,
+  OTA_FAILED,
+};
+
+// Registers the characteristics. Call with the other registrations, before
+// bt_start.
+void ota_register();
+// True once an update is written and verified. The caller should flush
+// anything it needs to and restart.
+bool ota_restart_due();
+// Call once the app has shown it works, after a full pass of the main loop
+// and before any sleep or restart. On the first boot of an update this keeps
+// the new image. An update that crashes or resets before getting here is
+// rolled back by the bootloader. Only checks once per boot.
+void ota_confirm_boot();
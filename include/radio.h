@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "time.h"
+
+// How long before a light transition to open a window, so the transition
+// runs on a freshly synced clock
+#define RADIO_WINDOW_LEAD_S 60
+// Give up on a window that hasn't finished in this long
+#define RADIO_WINDOW_TIMEOUT_S 30
+// Failed windows are retried after this long, doubling up to the max
+#define RADIO_BACKOFF_MIN_S 60
+#define RADIO_BACKOFF_MAX_S (6 * 60 * 60)
+
+// Plans when WiFi is up. Rather than staying connected, the radio comes up for
+// short windows that bundle an SNTP sync and any timezone refresh it starts,
+// then goes back off. Windows are timed to land
+// just before the light transition at which a sync falls due.
+//
+// Whether a window should open now, given the time of the next light
+// transition. The caller should make sure the network time manager is
+// initialized and then call radio_open_window.
+bool radio_window_due(time_t next_transition);
+void radio_open_window(const char *network_name, const char *network_pswd);
+// Hands the WiFi credentials to the radio. Does nothing if they haven't
+// changed. Otherwise an open window reconnects with them in place, keeping
+// Bluetooth up and starting its timeout again. With no window open, one opens
+// as soon as possible to try them.
+void radio_set_credentials(const char *network_name, const char *network_pswd);
+// Must be called from the main task. Closes the window once its work is done
+// or it times out.
+void radio_poll();
+// When radio_poll or radio_window_due next need to run, UINT64_MAX if
+// nothing is planned.
+uint64_t radio_next_update_millis();
+bool radio_window_open();
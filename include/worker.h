@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+
+// A shared task for occasional background jobs that would otherwise each need
+// a task of their own. The task is only created while jobs are queued and
+// deletes itself once the queue drains, so its stack is free the rest of the
+// time. Jobs run one at a time in the order they were submitted.
+typedef void (*worker_job_fn)(void *arg);
+
+// Returns false if the queue is full or the task couldn't be created.
+bool worker_submit(worker_job_fn fn, void *arg);
+// True while a job is queued or running. Don't sleep while it is.
+bool worker_is_busy();
+// The least free stack seen at the end of any job, in bytes, for sizing
+// WORKER_STACK_SIZE. SIZE_MAX if no job has run yet.
+size_t worker_min_free_stack();
@@ -0,0 +1,70 @@
+#include "ClockDrift.h"
+
+#include <stdlib.h>
+
+bool clock_drift_add_sample(ClockDrift &drift, int32_t offset_ms, uint32_t elapsed_s) {
+  if (elapsed_s < CLOCK_DRIFT_MIN_SAMPLE_S) {
+    return false;
+  }
+  // ms per s is thousandths, so scale by 1e6 more for parts per billion
+  int64_t rate = (int64_t)offset_ms * 1000000 / elapsed_s;
+  if (llabs(rate) > (int64_t)CLOCK_DRIFT_MAX_PPM * 1000) {
+    return false;
+  }
+
+  // SNTP jitter alone can move a sample this far
+  int64_t jitter = 2 * (int64_t)CLOCK_DRIFT_SYNC_ERROR_MS * 1000000 / elapsed_s;
+  int64_t error = rate - drift.rate_ppb;
+  if (drift.samples == 0 || llabs(error) > 4 * (int64_t)drift.deviation_ppb + jitter) {
+    // Something changed, e.g. the device went from staying awake on the
+    // crystal to deep sleeping on the RC oscillator. Start over rather than
+    // slowly averaging the old rate away.
+    drift.rate_ppb = rate;
+    drift.deviation_ppb = llabs(rate) / 2;
+    drift.samples = 0;
+  } else {
+    // SNTP jitter matters less the longer the sample, so weigh a sample by its
+    // length against the last one. Equal lengths get the usual gain of 1/4.
+    int64_t weight = elapsed_s;
+    int64_t total = weight + 3 * (int64_t)drift.last_elapsed_s;
+    drift.rate_ppb += error * weight / total;
+    drift.deviation_ppb += (llabs(error) - (int64_t)drift.deviation_ppb) * weight / total;
+  }
+  drift.last_elapsed_s = elapsed_s;
+  if (drift.samples < UINT16_MAX) {
+    drift.samples++;
+  }
+  return true;
+}
+
+static uint64_t margin_ppb(const ClockDrift &drift) {
+  return llabs(drift.rate_ppb) + 2 * (uint64_t)drift.deviation_ppb;
+}
+
+uint32_t clock_drift_predicted_error_ms(const ClockDrift &drift, uint32_t interval_s) {
+  if (drift.samples == 0) {
+    return UINT32_MAX;
+  }
+  uint64_t error_ms = CLOCK_DRIFT_SYNC_ERROR_MS + margin_ppb(drift) * interval_s / 1000000;
+  return error_ms < UINT32_MAX ? error_ms : UINT32_MAX;
+}
+
+uint32_t clock_drift_next_interval_s(const ClockDrift &drift, uint32_t max_error_ms,
+                                     uint32_t min_s, uint32_t max_s) {
+  if (drift.samples == 0 || max_error_ms <= CLOCK_DRIFT_SYNC_ERROR_MS) {
+    return min_s;
+  }
+
+  uint64_t interval = max_s;
+  uint64_t margin = margin_ppb(drift);
+  if (margin > 0) {
+    interval = (uint64_t)(max_error_ms - CLOCK_DRIFT_SYNC_ERROR_MS) * 1000000 / margin;
+  }
+  if (interval > 2 * (uint64_t)drift.last_elapsed_s) {
+    interval = 2 * (uint64_t)drift.last_elapsed_s;
+  }
+  if (interval > max_s) {
+    interval = max_s;
+  }
+  return interval > min_s ? interval : min_s;
+}
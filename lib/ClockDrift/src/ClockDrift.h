@@ -0,0 +1,38 @@
+#pragma once
+
+#include "stdint.h"
+
+// Syncs closer together than this say more about SNTP jitter than drift
+#define CLOCK_DRIFT_MIN_SAMPLE_S 60
+// Anything faster is a clock that was set by hand, not drift. The RTC runs off
+// the uncalibrated 150 kHz RC oscillator in deep sleep, which is only good to
+// a few percent.
+#define CLOCK_DRIFT_MAX_PPM 100000
+// How far off the clock may still be right after a sync
+#define CLOCK_DRIFT_SYNC_ERROR_MS 100
+
+// Running estimate of how fast the clock gains (positive) or loses time. Kept
+// plain so it can live in RTC memory across deep sleep; zero-initialize to
+// start with no samples.
+struct ClockDrift {
+  // Smoothed rate and mean deviation from it, much as TCP smooths RTTs
+  int32_t rate_ppb;
+  uint32_t deviation_ppb;
+  uint32_t last_elapsed_s;
+  uint16_t samples;
+};
+
+// Records a sync that found the clock `offset_ms` ahead of the server
+// (negative if behind), `elapsed_s` after the previous sync. Returns false if
+// the sample was too short or implausible and was ignored.
+bool clock_drift_add_sample(ClockDrift &drift, int32_t offset_ms, uint32_t elapsed_s);
+
+// Worst error expected `interval_s` after a sync, erring on the high side
+// while the estimate is unsettled.
+uint32_t clock_drift_predicted_error_ms(const ClockDrift &drift, uint32_t interval_s);
+
+// Longest interval until the next sync that keeps the predicted error under
+// `max_error_ms`, within [min_s, max_s]. Grows at most twofold per sync so a
+// lucky early estimate can't push the next sync days out.
+uint32_t clock_drift_next_interval_s(const ClockDrift &drift, uint32_t max_error_ms,
+                                     uint32_t min_s, uint32_t max_s);
@@ -0,0 +1,27 @@
+#include "Gamma.h"
+
+static constexpr GammaTable TABLE = gamma_make_table();
+
+static_assert(TABLE.duty[0] == 0, "Level 0 must be fully off");
+static_assert(TABLE.duty[GAMMA_LEVELS - 1] == GAMMA_DUTY_MAX, "Level 255 must be fully on");
+
+uint16_t gamma_duty(uint16_t level) {
+  uint8_t index = level >> 8;
+  uint8_t fraction = level & 0xff;
+  if (fraction == 0) {
+    return TABLE.duty[index];
+  }
+
+  // A non-zero fraction means index is below 255 so index + 1 is in range
+  uint32_t low = TABLE.duty[index];
+  uint32_t high = TABLE.duty[index + 1];
+  return low + (((high - low) * fraction + 0x80) >> 8);
+}
+
+uint16_t gamma_fade_level(uint16_t from, uint16_t to, uint32_t elapsed_ms, uint32_t duration_ms) {
+  if (elapsed_ms >= duration_ms) {
+    return to;
+  }
+  int32_t delta = (int32_t)to - (int32_t)from;
+  return from + (int32_t)((int64_t)delta * elapsed_ms / duration_ms);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "stdint.h"
+
+// LEDC runs off the ~8 MHz RTC clock at 1 kHz, which leaves 12 bits of duty
+// resolution.
+#define GAMMA_DUTY_BITS 12
+#define GAMMA_DUTY_MAX ((1 << GAMMA_DUTY_BITS) - 1)
+#define GAMMA_LEVELS 256
+
+// Brightness levels are 8.8 fixed point so fades can move between the 256
+// user-visible levels without stepping the output.
+#define GAMMA_LEVEL(level) ((uint16_t)((level) << 8))
+
+struct GammaTable {
+  uint16_t duty[GAMMA_LEVELS];
+};
+
+// Maps each 8-bit level to a duty using CIE 1931 lightness, so equal level
+// steps look like equal brightness steps.
+constexpr GammaTable gamma_make_table() {
+  GammaTable table{};
+  for (int i = 0; i < GAMMA_LEVELS; i++) {
+    double lightness = i * 100.0 / (GAMMA_LEVELS - 1);
+    double luminance = lightness <= 8 ? lightness / 903.3
+                                      : ((lightness + 16) / 116) * ((lightness + 16) / 116) *
+                                            ((lightness + 16) / 116);
+    table.duty[i] = (uint16_t)(luminance * GAMMA_DUTY_MAX + 0.5);
+  }
+  return table;
+}
+
+// Duty for an 8.8 fixed point level, interpolating between table entries
+uint16_t gamma_duty(uint16_t level);
+
+// Level `elapsed_ms` into a linear fade between two 8.8 fixed point levels
+uint16_t gamma_fade_level(uint16_t from, uint16_t to, uint32_t elapsed_ms, uint32_t duration_ms);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <assert.h>
+#include <initializer_list>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+// A vector with fixed capacity whose items live inline, so it never touches
+// the heap and can be copied or placed in static or RTC memory as is. Items
+// past size() are default constructed and unused.
+template <typename T, size_t N> class InlineVector {
+public:
+  InlineVector() = default;
+  InlineVector(std::initializer_list<T> items) {
+    assert(items.size() <= N);
+    for (const T &item : items) {
+      push_back(item);
+    }
+  }
+
+  static constexpr size_t capacity() { return N; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  bool full() const { return size_ == N; }
+
+  T *begin() { return items_; }
+  T *end() { return items_ + size_; }
+  const T *begin() const { return items_; }
+  const T *end() const { return items_ + size_; }
+
+  T &operator[](size_t idx) { return items_[idx]; }
+  const T &operator[](size_t idx) const { return items_[idx]; }
+  T &at(size_t idx) {
+    assert(idx < size_);
+    return items_[idx];
+  }
+  const T &at(size_t idx) const {
+    assert(idx < size_);
+    return items_[idx];
+  }
+  T &front() { return items_[0]; }
+  const T &front() const { return items_[0]; }
+  T &back() { return items_[size_ - 1]; }
+  const T &back() const { return items_[size_ - 1]; }
+
+  // Returns false without adding anything if the vector is full
+  bool push_back(const T &item) {
+    if (full()) {
+      return false;
+    }
+    items_[size_++] = item;
+    return true;
+  }
+
+  // Returns false and leaves the vector unchanged if `size` exceeds capacity
+  bool resize(size_t size) {
+    if (size > N) {
+      return false;
+    }
+    for (size_t i = size_; i < size; i++) {
+      items_[i] = T{};
+    }
+    size_ = size;
+    return true;
+  }
+
+  void clear() { size_ = 0; }
+
+private:
+  T items_[N]{};
+  // A byte for the small capacities stored on the device
+  typename std::conditional<N <= UINT8_MAX, uint8_t, uint16_t>::type size_ = 0;
+
+  static_assert(N <= UINT16_MAX, "InlineVector size is stored in a uint16_t");
+};
@@ -1,43 +1,201 @@
 #include "LightManager.h"
 
-// Return 0 if equal, 1 if t1 > t2, else -1
-int cmpHrMin(LightManager::HrMin t1, LightManager::HrMin t2) {
-  if (t1.hour == t2.hour && t1.minute == t2.minute) {
-    return 0;
-  } else if (t1.hour > t2.hour || (t1.hour == t2.hour && t1.minute > t2.minute)) {
-    return 1;
-  } else {
-    return -1;
+#include <algorithm>
+#include <cstring>
+
+#define MINS_PER_DAY (24 * 60)
+#define MINS_PER_WEEK (7 * MINS_PER_DAY)
+#define SECS_PER_DAY (MINS_PER_DAY * 60)
+
+static_assert(sizeof(LightManager::Action) == LIGHT_MANAGER_ACTION_SIZE,
+              "Action should pack into the same size as its encoding");
+static_assert(LIGHT_MANAGER_TIMELINE_SIZE <= UINT16_MAX, "Timeline offsets are 16-bit");
+
+void LightManager::compile(const Profiles &profiles, Timeline &timeline) {
+  timeline.transitions.clear();
+  timeline.offsets.clear();
+
+  for (const Profile &profile : profiles) {
+    timeline.offsets.push_back(timeline.transitions.size());
+
+    // The actions by time of day. An insertion sort is stable, so when two
+    // actions share a minute the later one still wins, matching the order
+    // they were configured in, and it needs no scratch space.
+    InlineVector<uint16_t, LIGHT_MANAGER_MAX_ACTIONS> order;
+    for (size_t i = 0; i < profile.actions.size(); i++) {
+      order.push_back(i);
+      for (size_t j = order.size() - 1; j > 0; j--) {
+        const HrMin &a = profile.actions[order[j - 1]].time;
+        const HrMin &b = profile.actions[order[j]].time;
+        if (a.hour * 60 + a.minute <= b.hour * 60 + b.minute) {
+          break;
+        }
+        std::swap(order[j - 1], order[j]);
+      }
+    }
+
+    // Day by day in time order is already sorted by minute of the week
+    for (uint16_t day = 0; day < 7; day++) {
+      for (uint16_t i : order) {
+        const Action &action = profile.actions[i];
+        if (!(action.days & (1 << day))) {
+          continue;
+        }
+        timeline.transitions.push_back(Transition{
+            .minuteOfWeek =
+                (uint16_t)(day * MINS_PER_DAY + action.time.hour * 60 + action.time.minute),
+            .action = i});
+      }
+    }
+  }
+  timeline.offsets.push_back(timeline.transitions.size());
+}
+
+size_t LightManager::encode(const Actions &actions, uint8_t *buf) {
+  uint8_t *out = buf;
+  for (const Action &action : actions) {
+    *out++ = action.time.hour;
+    *out++ = action.time.minute;
+    for (uint8_t c : action.color) {
+      *out++ = c;
+    }
+    *out++ = action.days;
+  }
+  return out - buf;
+}
+
+bool LightManager::decode(const uint8_t *buf, size_t size, Actions &actions) {
+  if (size % LIGHT_MANAGER_ACTION_SIZE != 0 ||
+      !actions.resize(size / LIGHT_MANAGER_ACTION_SIZE)) {
+    return false;
+  }
+
+  for (Action &action : actions) {
+    action.time = HrMin{buf[0], buf[1]};
+    action.color = Color{buf[2], buf[3], buf[4]};
+    action.days = buf[5];
+    buf += LIGHT_MANAGER_ACTION_SIZE;
+    if (action.days == 0) {
+      return false;
+    }
+  }
+  return !actions.empty();
+}
+
+bool LightManager::setProfile(const char *name) {
+  for (size_t i = 0; i < profiles_.size(); i++) {
+    if (strncmp(profiles_[i].name, name, sizeof(profiles_[i].name)) == 0) {
+      return setProfile(i);
+    }
+  }
+  return false;
+}
+
+bool LightManager::setProfile(size_t idx) {
+  if (idx >= profiles_.size()) {
+    return false;
+  }
+  if (idx != profile_) {
+    planned_ = false;
+  }
+  profile_ = idx;
+  return true;
+}
+
+void LightManager::compileIfNeeded() {
+  if (!compiled_) {
+    compile(profiles_, timeline_);
+    compiled_ = true;
   }
 }
 
 LightManager::Next LightManager::update(tm timeinfo) {
-  HrMin now{(uint8_t)timeinfo.tm_hour, (uint8_t)timeinfo.tm_min};
-  Action before = actions_.back();
-  Action after = actions_.front();
-  Action curr;
-  for (size_t i = 0; i < actions_.size(); i++) {
-    curr = actions_.at(i);
-
-    if (cmpHrMin(curr.time, now) == 1) {
-      // If this is the first position where `curr` is after the current time,
-      // update `after` and break.
-      after = curr;
-      break;
-    } else {
-      // If `curr` is still before the current time, update `before` and
-      before = curr;
-    }
-  }
-
-  int next_update_hrs = after.time.hour - now.hour;
-  if (cmpHrMin(after.time, now) < 0) {
-    // If after is before now, it happens tomorrow so wrap around
-    next_update_hrs += 24;
-  }
-
-  return Next{.color = {before.color[0], before.color[1], before.color[2]},
-              .nextUpdateSecs =
-                  (uint32_t)((next_update_hrs * 60 + (after.time.minute - now.minute)) * 60 -
-                             timeinfo.tm_sec)};
+  compileIfNeeded();
+
+  const Transition *begin = timeline_.transitions.begin() + timeline_.offsets[profile_];
+  const Transition *end = timeline_.transitions.begin() + timeline_.offsets[profile_ + 1];
+
+  int32_t now = timeinfo.tm_wday * MINS_PER_DAY + timeinfo.tm_hour * 60 + timeinfo.tm_min;
+
+  // Nothing ever happens, e.g. every action has no days, so keep the light
+  // off and look again in a week
+  if (begin == end) {
+    return Next{.color = Color{0, 0, 0}, .nextUpdateSecs = MINS_PER_WEEK * 60};
+  }
+
+  // First transition strictly after the current minute. An action scheduled
+  // for exactly now is already active.
+  const Transition *it = std::upper_bound(
+      begin, end, now, [](int32_t t, const Transition &tr) { return t < tr.minuteOfWeek; });
+
+  const Transition &before = (it == begin) ? *(end - 1) : *(it - 1);
+  const Transition &after = (it == end) ? *begin : *it;
+
+  int32_t next_update_mins = after.minuteOfWeek - now;
+  if (it == end) {
+    // The next transition is in the following week so wrap around
+    next_update_mins += MINS_PER_WEEK;
+  }
+
+  const Actions &actions = profiles_[profile_].actions;
+  return Next{.color = actions[before.action].color,
+              .nextUpdateSecs = (uint32_t)(next_update_mins * 60 - timeinfo.tm_sec)};
+}
+
+size_t LightManager::plan(time_t now, const PosixTz &tz, time_t *instants) {
+  compileIfNeeded();
+
+  const Transition *begin = timeline_.transitions.begin() + timeline_.offsets[profile_];
+  const Transition *end = timeline_.transitions.begin() + timeline_.offsets[profile_ + 1];
+
+  time_t horizon = now + LIGHT_MANAGER_PLAN_DAYS * SECS_PER_DAY;
+  int64_t local = now + tz.offset(now);
+  int64_t today = local / SECS_PER_DAY - (local % SECS_PER_DAY < 0);
+  size_t size = 0;
+
+  // Each local day's transitions are converted separately since the offset
+  // can differ from one day, or one hour, to the next
+  for (int64_t day = today; day <= today + LIGHT_MANAGER_PLAN_DAYS; day++) {
+    // The epoch was a Thursday
+    uint16_t weekStart = ((day + 4) % 7 + 7) % 7 * MINS_PER_DAY;
+    const Transition *it = std::lower_bound(
+        begin, end, weekStart,
+        [](const Transition &tr, uint16_t t) { return tr.minuteOfWeek < t; });
+
+    for (; it != end && it->minuteOfWeek < weekStart + MINS_PER_DAY; it++) {
+      time_t at = tz.toUtc(day * SECS_PER_DAY + (it->minuteOfWeek - weekStart) * 60);
+      // Several transitions can land on the same instant, e.g. two in an hour
+      // that was skipped, and one wake covers them all
+      if (at <= now || at > horizon || (size > 0 && at == instants[size - 1])) {
+        continue;
+      }
+      instants[size++] = at;
+    }
+  }
+  return size;
+}
+
+time_t LightManager::nextTransition(time_t now, const PosixTz &tz) {
+  // A plan made from a later time than now is missing transitions, e.g. if
+  // the clock was set back
+  if (planned_ && now >= planStart_ && tz == planTz_) {
+    time_t *next = std::upper_bound(plan_, plan_ + planSize_, now);
+    if (next != plan_ + planSize_) {
+      return *next;
+    }
+  }
+
+  // Plan afresh, looking further ahead if the next few days have nothing on,
+  // e.g. for a profile that only has actions at the weekend
+  planStart_ = now;
+  planTz_ = tz;
+  planned_ = true;
+  for (time_t from = now; from < now + 7 * SECS_PER_DAY;
+       from += LIGHT_MANAGER_PLAN_DAYS * SECS_PER_DAY) {
+    planSize_ = plan(from, tz, plan_);
+    if (planSize_ > 0) {
+      return plan_[0];
+    }
+  }
+  return 0;
 }
@@ -1,30 +1,145 @@
 #pragma once
 
+#include "stddef.h"
 #include "stdint.h"
 #include "time.h"
-#include <vector>
+#include <array>
+
+#include "InlineVector.h"
+#include "PosixTz.h"
+
+#define LIGHT_MANAGER_PROFILE_NAME_SIZE 16
+#define LIGHT_MANAGER_MAX_PROFILES 4
+// Actions per profile. Profiles are stored inline, so this is kept small on
+// the device, where the stored record, the RTC snapshot and the Bluetooth
+// schedule also count actions in a byte. The native tests raise it from
+// build_flags to benchmark large schedules.
+#ifndef LIGHT_MANAGER_MAX_ACTIONS
+#define LIGHT_MANAGER_MAX_ACTIONS 24
+#endif
+// Bytes per action in the encoded form: hour, minute, red, green, blue, days
+#define LIGHT_MANAGER_ACTION_SIZE 6
+// How many days ahead transitions are planned as UTC instants. Each local day
+// in the plan has at most one transition per action.
+#define LIGHT_MANAGER_PLAN_DAYS 3
+#define LIGHT_MANAGER_PLAN_SIZE (LIGHT_MANAGER_MAX_ACTIONS * (LIGHT_MANAGER_PLAN_DAYS + 1))
+// Transitions in the compiled timeline: every profile's actions on every day
+#define LIGHT_MANAGER_TIMELINE_SIZE (LIGHT_MANAGER_MAX_PROFILES * LIGHT_MANAGER_MAX_ACTIONS * 7)
 
 class LightManager {
 public:
+  // Bitmask of the days an action applies to. Bit 0 is Sunday to match
+  // `tm_wday`.
+  enum Days : uint8_t {
+    SUNDAY = 1 << 0,
+    MONDAY = 1 << 1,
+    TUESDAY = 1 << 2,
+    WEDNESDAY = 1 << 3,
+    THURSDAY = 1 << 4,
+    FRIDAY = 1 << 5,
+    SATURDAY = 1 << 6,
+    WEEKDAYS = MONDAY | TUESDAY | WEDNESDAY | THURSDAY | FRIDAY,
+    WEEKEND = SATURDAY | SUNDAY,
+    EVERY_DAY = WEEKDAYS | WEEKEND,
+  };
+
   struct HrMin {
     uint8_t hour, minute;
   };
 
+  typedef std::array<uint8_t, 3> Color;
+
+  // Colors are held by value so actions can be copied, persisted and restored
+  // without pointing into anything.
   struct Action {
     HrMin time;
-    uint8_t *color[3];
+    Color color;
+    uint8_t days = EVERY_DAY;
   };
 
+  typedef InlineVector<Action, LIGHT_MANAGER_MAX_ACTIONS> Actions;
+
   struct Next {
-    uint8_t *color[3];
+    Color color;
     uint32_t nextUpdateSecs;
   };
 
-  // actions must be in ascending order by time
-  LightManager(std::vector<Action> &actions) : actions_(actions){};
+  // A named set of actions. Actions may be in any order but every profile
+  // must have at least one action.
+  struct Profile {
+    char name[LIGHT_MANAGER_PROFILE_NAME_SIZE];
+    Actions actions;
+  };
+
+  typedef InlineVector<Profile, LIGHT_MANAGER_MAX_PROFILES> Profiles;
+
+  struct Transition {
+    uint16_t minuteOfWeek;
+    // Index into the profile's actions
+    uint16_t action;
+  };
+
+  // Every profile's transitions in one flat array. Profile `i` occupies
+  // [offsets[i], offsets[i + 1]) and is sorted by minute of the week, so
+  // evaluating the active profile is a binary search over just its own
+  // transitions regardless of how many profiles exist. Sized for full
+  // profiles so recompiling never touches the heap.
+  struct Timeline {
+    InlineVector<Transition, LIGHT_MANAGER_TIMELINE_SIZE> transitions;
+    InlineVector<uint16_t, LIGHT_MANAGER_MAX_PROFILES + 1> offsets;
+  };
+
+  // Replaces `timeline` with the one for `profiles`
+  static void compile(const Profiles &profiles, Timeline &timeline);
+
+  // Encodes actions in a stable byte layout of LIGHT_MANAGER_ACTION_SIZE bytes
+  // each, independent of the in-memory struct. `buf` must hold
+  // LIGHT_MANAGER_MAX_ACTIONS * LIGHT_MANAGER_ACTION_SIZE bytes. Returns the
+  // encoded size.
+  static size_t encode(const Actions &actions, uint8_t *buf);
+  // Returns false if `size` isn't a whole number of actions within capacity,
+  // or if the actions would never run: there are none or one has no days.
+  static bool decode(const uint8_t *buf, size_t size, Actions &actions);
+
+  LightManager(Profiles &profiles) : profiles_(profiles){};
 
   Next update(tm timeinfo);
 
+  // Expands the active profile into the UTC instants of its transitions in
+  // (now, now + LIGHT_MANAGER_PLAN_DAYS days], soonest first, following `tz`
+  // across DST changes. A transition in the hour skipped when the clocks go
+  // forward happens at the change, and one in the hour repeated when they go
+  // back happens only the first time. `instants` must hold
+  // LIGHT_MANAGER_PLAN_SIZE. Returns how many were written.
+  size_t plan(time_t now, const PosixTz &tz, time_t *instants);
+  // The first planned transition strictly after `now`, or 0 if the profile
+  // has none. The plan is kept and only rebuilt once it runs out, or when the
+  // profile, its actions or `tz` change.
+  time_t nextTransition(time_t now, const PosixTz &tz);
+
+  // Returns false if there is no profile with the given name
+  bool setProfile(const char *name);
+  bool setProfile(size_t idx);
+  size_t profile() { return profile_; }
+
+  // Must be called after `profiles` is modified so the timeline is rebuilt on
+  // the next update.
+  void invalidate() {
+    compiled_ = false;
+    planned_ = false;
+  }
+
 private:
-  std::vector<Action> &actions_;
+  void compileIfNeeded();
+
+  Profiles &profiles_;
+  Timeline timeline_;
+  size_t profile_ = 0;
+  bool compiled_ = false;
+
+  time_t plan_[LIGHT_MANAGER_PLAN_SIZE];
+  size_t planSize_ = 0;
+  time_t planStart_ = 0;
+  PosixTz planTz_;
+  bool planned_ = false;
 };
@@ -0,0 +1,272 @@
+#include "PosixTz.h"
+
+#include <ctype.h>
+#include <initializer_list>
+
+#define SECS_PER_DAY (24 * 60 * 60)
+// POSIX allows rule times up to a week either side of midnight
+#define MAX_RULE_HOURS 167
+// A change at 02:00 local time, the default for rules that leave it out
+#define DEFAULT_RULE_TIME (2 * 60 * 60)
+
+static int64_t floorDiv(int64_t a, int64_t b) { return a / b - (a % b != 0 && (a < 0) != (b < 0)); }
+
+// Days since the epoch of a proleptic Gregorian date, from Howard Hinnant's
+// chrono-compatible date algorithms
+static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  int64_t era = floorDiv(y, 400);
+  unsigned yoe = (unsigned)(y - era * 400);
+  unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468;
+}
+
+static int64_t yearFromDays(int64_t z) {
+  z += 719468;
+  int64_t era = floorDiv(z, 146097);
+  unsigned doe = (unsigned)(z - era * 146097);
+  unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  unsigned mp = (5 * doy + 2) / 153;
+  return (int64_t)yoe + era * 400 + (mp >= 10);
+}
+
+static bool isLeap(int64_t y) { return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0; }
+
+// Days since the epoch of the day `rule` falls on in `year`
+static int64_t ruleDay(const PosixTz::Rule &rule, int64_t year) {
+  int64_t jan1 = daysFromCivil(year, 1, 1);
+  switch (rule.kind) {
+  case PosixTz::Rule::JULIAN:
+    return jan1 + rule.day - 1 + (isLeap(year) && rule.day >= 60);
+  case PosixTz::Rule::ZERO_JULIAN:
+    return jan1 + rule.day;
+  case PosixTz::Rule::MONTH_WEEK_DAY:
+    break;
+  }
+
+  int64_t first = daysFromCivil(year, rule.month, 1);
+  int64_t next = rule.month == 12 ? daysFromCivil(year + 1, 1, 1)
+                                  : daysFromCivil(year, rule.month + 1, 1);
+  // The epoch was a Thursday
+  int firstWeekday = (int)(((first + 4) % 7 + 7) % 7);
+  int64_t day = first + (rule.weekday - firstWeekday + 7) % 7 + (rule.week - 1) * 7;
+  while (day >= next) {
+    day -= 7; // Week 5 is the last, which some months only have four of
+  }
+  return day;
+}
+
+static bool parseNumber(const char **p, int min, int max, int *value) {
+  if (!isdigit((unsigned char)**p)) {
+    return false;
+  }
+  int n = 0;
+  while (isdigit((unsigned char)**p)) {
+    n = n * 10 + (*(*p)++ - '0');
+    if (n > max) {
+      return false;
+    }
+  }
+  *value = n;
+  return n >= min;
+}
+
+// [+|-]hh[:mm[:ss]], in seconds
+static bool parseTime(const char **p, int maxHours, int32_t *secs) {
+  int sign = 1;
+  if (**p == '+' || **p == '-') {
+    sign = *(*p)++ == '-' ? -1 : 1;
+  }
+  int hours, minutes = 0, seconds = 0;
+  if (!parseNumber(p, 0, maxHours, &hours)) {
+    return false;
+  }
+  if (**p == ':') {
+    (*p)++;
+    if (!parseNumber(p, 0, 59, &minutes)) {
+      return false;
+    }
+    if (**p == ':') {
+      (*p)++;
+      if (!parseNumber(p, 0, 59, &seconds)) {
+        return false;
+      }
+    }
+  }
+  *secs = sign * (hours * 3600 + minutes * 60 + seconds);
+  return true;
+}
+
+// Either three or more letters, or anything quoted in <>, e.g. "<+0530>"
+static bool parseName(const char **p) {
+  const char *start = *p;
+  if (**p == '<') {
+    while (**p && **p != '>') {
+      (*p)++;
+    }
+    if (**p != '>') {
+      return false;
+    }
+    (*p)++;
+    return *p - start >= 5;
+  }
+  while (isalpha((unsigned char)**p)) {
+    (*p)++;
+  }
+  return *p - start >= 3;
+}
+
+static bool parseRule(const char **p, PosixTz::Rule *rule) {
+  int month, week, weekday, day;
+  if (**p == 'M') {
+    (*p)++;
+    if (!parseNumber(p, 1, 12, &month) || *(*p)++ != '.' || !parseNumber(p, 1, 5, &week) ||
+        *(*p)++ != '.' || !parseNumber(p, 0, 6, &weekday)) {
+      return false;
+    }
+    *rule = PosixTz::Rule{PosixTz::Rule::MONTH_WEEK_DAY, (uint8_t)month, (uint8_t)week,
+                          (uint8_t)weekday, 0, DEFAULT_RULE_TIME};
+  } else if (**p == 'J') {
+    (*p)++;
+    if (!parseNumber(p, 1, 365, &day)) {
+      return false;
+    }
+    *rule = PosixTz::Rule{PosixTz::Rule::JULIAN, 0, 0, 0, (uint16_t)day, DEFAULT_RULE_TIME};
+  } else {
+    if (!parseNumber(p, 0, 365, &day)) {
+      return false;
+    }
+    *rule = PosixTz::Rule{PosixTz::Rule::ZERO_JULIAN, 0, 0, 0, (uint16_t)day, DEFAULT_RULE_TIME};
+  }
+
+  if (**p == '/') {
+    (*p)++;
+    return parseTime(p, MAX_RULE_HOURS, &rule->time);
+  }
+  return true;
+}
+
+bool PosixTz::parse(const char *tz) {
+  if (tz == nullptr) {
+    return false;
+  }
+
+  PosixTz parsed;
+  const char *p = tz;
+  int32_t offset = 0;
+  if (!parseName(&p)) {
+    return false;
+  }
+  // Strictly the offset is required, but "UTC" is common enough to allow
+  if (*p && !parseTime(&p, 24, &offset)) {
+    return false;
+  }
+  // POSIX offsets are west of UTC, the opposite of what everything else uses
+  parsed.stdOffset_ = parsed.dstOffset_ = -offset;
+
+  if (*p) {
+    if (!parseName(&p)) {
+      return false;
+    }
+    parsed.hasDst_ = true;
+    parsed.dstOffset_ = parsed.stdOffset_ + 60 * 60;
+    if (*p && *p != ',') {
+      if (!parseTime(&p, 24, &offset)) {
+        return false;
+      }
+      parsed.dstOffset_ = -offset;
+    }
+
+    if (*p == ',') {
+      p++;
+      if (!parseRule(&p, &parsed.start_) || *p++ != ',' || !parseRule(&p, &parsed.end_)) {
+        return false;
+      }
+    } else {
+      const char *us = "M3.2.0,M11.1.0";
+      parseRule(&us, &parsed.start_);
+      us++;
+      parseRule(&us, &parsed.end_);
+    }
+  }
+
+  if (*p) {
+    return false;
+  }
+  *this = parsed;
+  return true;
+}
+
+void PosixTz::changes(int64_t year, time_t *start, time_t *end) const {
+  // The start is given in standard time and the end in DST
+  *start = ruleDay(start_, year) * SECS_PER_DAY + start_.time - stdOffset_;
+  *end = ruleDay(end_, year) * SECS_PER_DAY + end_.time - dstOffset_;
+}
+
+bool PosixTz::isDst(time_t utc) const {
+  if (!hasDst_) {
+    return false;
+  }
+
+  time_t start, end;
+  changes(yearFromDays(floorDiv(utc, SECS_PER_DAY)), &start, &end);
+  if (start < end) {
+    return start <= utc && utc < end;
+  }
+  // DST spans the new year, as in the southern hemisphere
+  return utc < end || start <= utc;
+}
+
+int32_t PosixTz::offset(time_t utc) const { return isDst(utc) ? dstOffset_ : stdOffset_; }
+
+time_t PosixTz::toUtc(int64_t local) const {
+  time_t asStd = local - stdOffset_;
+  time_t asDst = local - dstOffset_;
+  bool stdValid = !isDst(asStd);
+  bool dstValid = hasDst_ && isDst(asDst);
+
+  if (stdValid && dstValid) {
+    return asStd < asDst ? asStd : asDst;
+  } else if (stdValid) {
+    return asStd;
+  } else if (dstValid) {
+    return asDst;
+  }
+  // Skipped, so the change that skipped it lies between the two readings
+  return nextChange(asStd < asDst ? asStd : asDst);
+}
+
+time_t PosixTz::nextChange(time_t utc) const {
+  if (!hasDst_) {
+    return 0;
+  }
+
+  int64_t year = yearFromDays(floorDiv(utc, SECS_PER_DAY));
+  time_t next = 0;
+  // Rule times can push a change into the neighbouring year
+  for (int64_t y = year - 1; y <= year + 1; y++) {
+    time_t start, end;
+    changes(y, &start, &end);
+    for (time_t change : {start, end}) {
+      if (change > utc && (next == 0 || change < next)) {
+        next = change;
+      }
+    }
+  }
+  return next;
+}
+
+static bool operator==(const PosixTz::Rule &a, const PosixTz::Rule &b) {
+  return a.kind == b.kind && a.month == b.month && a.week == b.week && a.weekday == b.weekday &&
+         a.day == b.day && a.time == b.time;
+}
+
+bool PosixTz::operator==(const PosixTz &other) const {
+  if (stdOffset_ != other.stdOffset_ || hasDst_ != other.hasDst_) {
+    return false;
+  }
+  return !hasDst_ ||
+         (dstOffset_ == other.dstOffset_ && start_ == other.start_ && end_ == other.end_);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+// The rules in a POSIX TZ string such as "EST5EDT,M3.2.0,M11.1.0", evaluated
+// directly rather than through the C library's single global TZ, so any
+// instant, in any year and either side of a DST change, can be converted
+// between UTC and local time. Default constructed it's UTC.
+class PosixTz {
+public:
+  // When in the year a DST change happens
+  struct Rule {
+    enum Kind : uint8_t {
+      // Jn: day 1 to 365, never counting February 29th
+      JULIAN,
+      // n: day 0 to 365, counting February 29th
+      ZERO_JULIAN,
+      // Mm.w.d: weekday d (0 is Sunday) of week w (5 is the last) of month m
+      MONTH_WEEK_DAY,
+    };
+
+    Kind kind;
+    uint8_t month, week, weekday;
+    uint16_t day;
+    // Seconds after local midnight, which may be negative or past a day
+    int32_t time;
+  };
+
+  // Returns false and leaves this unchanged if `tz` isn't a valid TZ string.
+  // A DST name without rules gets the US rules, as in glibc and newlib.
+  bool parse(const char *tz);
+
+  bool hasDst() const { return hasDst_; }
+  bool isDst(time_t utc) const;
+  // Seconds east of UTC at `utc`, so local time is `utc + offset(utc)`
+  int32_t offset(time_t utc) const;
+  // Converts a local wall clock time, counted in seconds since the epoch as if
+  // it were UTC, to the UTC instant it happens. A time repeated when the
+  // clocks go back is taken at its first occurrence, and a time skipped when
+  // they go forward at the moment of the change, when it would have been.
+  time_t toUtc(int64_t local) const;
+  // The first DST change strictly after `utc`, or 0 if there's no DST
+  time_t nextChange(time_t utc) const;
+
+  bool operator==(const PosixTz &other) const;
+  bool operator!=(const PosixTz &other) const { return !(*this == other); }
+
+private:
+  // The UTC instants DST starts and ends in `year`
+  void changes(int64_t year, time_t *start, time_t *end) const;
+
+  int32_t stdOffset_ = 0;
+  int32_t dstOffset_ = 0;
+  bool hasDst_ = false;
+  Rule start_{};
+  Rule end_{};
+};
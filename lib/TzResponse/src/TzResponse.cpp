@@ -0,0 +1,77 @@
+#include "TzResponse.h"
+
+#include <string.h>
+
+void TzResponseParser::reset() {
+  state_ = State::STATUS;
+  result_ = Result::PENDING;
+  statusSize_ = 0;
+  valueSize_ = 0;
+  success_ = false;
+  value_[0] = 0;
+}
+
+void TzResponseParser::endStatus() {
+  if (statusSize_ == 7 && memcmp(status_, "success", 7) == 0) {
+    success_ = true;
+  } else if (statusSize_ == 4 && memcmp(status_, "fail", 4) == 0) {
+    success_ = false;
+  } else {
+    result_ = Result::INVALID;
+    state_ = State::DONE;
+    return;
+  }
+  state_ = State::VALUE;
+}
+
+void TzResponseParser::endValue() {
+  value_[valueSize_] = 0;
+  if (success_) {
+    result_ = valueSize_ > 0 ? Result::SUCCESS : Result::INVALID;
+  } else {
+    result_ = Result::FAILURE;
+  }
+  state_ = State::DONE;
+}
+
+void TzResponseParser::feed(const char *data, size_t size) {
+  for (size_t i = 0; i < size && state_ != State::DONE; i++) {
+    char c = data[i];
+    switch (state_) {
+    case State::STATUS:
+      if (c == ',') {
+        endStatus();
+      } else if (statusSize_ < sizeof(status_)) {
+        status_[statusSize_++] = c;
+      } else {
+        result_ = Result::INVALID;
+        state_ = State::DONE;
+      }
+      break;
+    case State::VALUE:
+      if (c == '\r' || c == '\n') {
+        endValue();
+      } else if (valueSize_ < sizeof(value_) - 1) {
+        value_[valueSize_++] = c;
+      } else if (success_) {
+        // A truncated zone would look up the wrong one, or none
+        result_ = Result::INVALID;
+        state_ = State::DONE;
+      }
+      // Failure messages are only logged, so just drop the rest
+      break;
+    case State::DONE:
+      break;
+    }
+  }
+}
+
+TzResponseParser::Result TzResponseParser::finish() {
+  if (state_ == State::VALUE) {
+    endValue();
+  } else if (state_ == State::STATUS) {
+    result_ = Result::INVALID;
+    state_ = State::DONE;
+  }
+  return result_;
+}
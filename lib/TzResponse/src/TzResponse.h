@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Room for the longest IANA zone name, or the start of an error message
+#define TZ_RESPONSE_VALUE_SIZE 48
+// "success" is the longest status we need to tell apart
+#define TZ_RESPONSE_STATUS_SIZE 8
+
+// Parses the CSV an ip-api.com style provider returns for
+// `fields=status,message,timezone`: a single line of "success,<zone>" or
+// "fail,<message>". Chunks are consumed as they arrive and only the value is
+// kept, so a response of any size costs the same fixed memory.
+class TzResponseParser {
+public:
+  enum class Result : uint8_t {
+    // Not enough of the response seen yet
+    PENDING,
+    // value() is the zone
+    SUCCESS,
+    // value() is the provider's message, possibly truncated
+    FAILURE,
+    // Not a response we understand, e.g. an HTML error page
+    INVALID,
+  };
+
+  TzResponseParser() { reset(); }
+  void reset();
+  // Consumes the next chunk of the body. Chunks may split it anywhere.
+  void feed(const char *data, size_t size);
+  // Call once the body has ended. A missing trailing newline is fine.
+  Result finish();
+  Result result() const { return result_; }
+  const char *value() const { return value_; }
+
+private:
+  enum class State : uint8_t { STATUS, VALUE, DONE };
+
+  void endStatus();
+  void endValue();
+
+  State state_;
+  Result result_;
+  uint8_t statusSize_;
+  uint8_t valueSize_;
+  bool success_;
+  char status_[TZ_RESPONSE_STATUS_SIZE];
+  char value_[TZ_RESPONSE_VALUE_SIZE];
+};
@@ -0,0 +1,170 @@
+"""Generates lib/Zones/src/zones_table.h from lib/Zones/zones.csv.
+
+The table is a minimal perfect hash over normalized zone names, so a lookup
+hashes the name once and checks a single entry. Names and POSIX strings live
+in one pool, each distinct string once, addressed by 16-bit offsets.
+
+PlatformIO runs this before each build (see extra_scripts in platformio.ini)
+and it only rewrites the table when zones.csv or this script has changed. It
+can also be run by hand: python3 lib/Zones/generate.py
+"""
+
+import csv
+import os
+import sys
+
+FNV_OFFSET = 0x811C9DC5
+FNV_PRIME = 0x01000193
+SEED_MULT = 0x9E3779B9
+MASK = 0xFFFFFFFF
+# Average keys per bucket. More means fewer seeds to store but a harder search.
+KEYS_PER_BUCKET = 4
+# The last buckets placed have few free slots left to hit
+MAX_SEED = 0xFFFF
+
+
+def normalize(name):
+    # Matches tz_name_cmp: case-insensitive, ignoring underscores after the
+    # first character
+    return name[0].lower() + "".join(c.lower() for c in name[1:] if c != "_")
+
+
+def fnv1a(s):
+    h = FNV_OFFSET
+    for c in s.encode():
+        h = ((h ^ c) * FNV_PRIME) & MASK
+    return h
+
+
+def mix(h):
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & MASK
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & MASK
+    h ^= h >> 16
+    return h
+
+
+def slot(h, seed, size):
+    return mix(h ^ ((seed * SEED_MULT) & MASK)) % size
+
+
+def build_hash(keys):
+    size = len(keys)
+    buckets_count = (size + KEYS_PER_BUCKET - 1) // KEYS_PER_BUCKET
+    hashes = {key: fnv1a(key) for key in keys}
+    buckets = [[] for _ in range(buckets_count)]
+    for key in keys:
+        buckets[hashes[key] % buckets_count].append(key)
+
+    seeds = [0] * buckets_count
+    slots = [None] * size
+    # Place the fullest buckets first while there's the most room
+    for b in sorted(range(buckets_count), key=lambda b: -len(buckets[b])):
+        for seed in range(MAX_SEED + 1):
+            taken = [slot(hashes[key], seed, size) for key in buckets[b]]
+            if len(set(taken)) == len(taken) and all(slots[s] is None for s in taken):
+                break
+        else:
+            sys.exit("generate.py: no seed fits bucket %d" % b)
+        seeds[b] = seed
+        for key, s in zip(buckets[b], taken):
+            slots[s] = key
+    return seeds, slots
+
+
+def c_string(s):
+    # Each string carries its own terminator so the pool can be one literal
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '\\0"'
+
+
+def generate(csv_path, out_path):
+    with open(csv_path, newline="") as f:
+        rows = [(row["name"], row["posix_str"]) for row in csv.DictReader(f)]
+    zones = {normalize(name): (name, posix) for name, posix in rows}
+    if len(zones) != len(rows):
+        sys.exit("generate.py: zone names collide once normalized")
+
+    seeds, slots = build_hash(list(zones))
+
+    pool = []
+    offsets = {}
+    pool_size = 0
+
+    def intern(s):
+        nonlocal pool_size
+        if s not in offsets:
+            offsets[s] = pool_size
+            pool.append(s)
+            pool_size += len(s) + 1
+        return offsets[s]
+
+    entries = []
+    for key in slots:
+        name, posix = zones[key]
+        entries.append((intern(key), intern(posix), name))
+    if pool_size > 0xFFFF:
+        sys.exit("generate.py: string pool no longer fits 16-bit offsets")
+
+    entries_size = 4 * len(entries)
+    total = pool_size + entries_size + 2 * len(seeds)
+    # The old table: two pointers per zone plus every name and each distinct
+    # POSIX string, which the compiler already merged.
+    old_total = (8 * len(rows) + sum(len(name) + 1 for name, _ in rows) +
+                 sum(len(posix) + 1 for posix in set(p for _, p in rows)))
+
+    lines = [
+        "// Generated by lib/Zones/generate.py from lib/Zones/zones.csv, don't edit.",
+        "// %d zones, %d distinct POSIX strings: %d bytes of strings, %d of entries" %
+        (len(rows), len(set(p for _, p in rows)), pool_size, entries_size),
+        "// and %d of seeds, %d in all (the sorted pointer table took %d)." %
+        (2 * len(seeds), total, old_total),
+        "#pragma once",
+        "",
+        "#include <stdint.h>",
+        "",
+        "#define MICRO_TZ_DB_SIZE %d" % len(entries),
+        "#define MICRO_TZ_DB_BUCKETS %d" % len(seeds),
+        "#define MICRO_TZ_DB_FNV_OFFSET 0x%08xu" % FNV_OFFSET,
+        "#define MICRO_TZ_DB_FNV_PRIME 0x%08xu" % FNV_PRIME,
+        "#define MICRO_TZ_DB_SEED_MULT 0x%08xu" % SEED_MULT,
+        "",
+        "typedef struct {",
+        "  // Offsets into micro_tz_db_pool of the normalized name and POSIX string",
+        "  uint16_t name;",
+        "  uint16_t posix_str;",
+        "} micro_tz_db_entry;",
+        "",
+        "static const uint16_t micro_tz_db_seeds[MICRO_TZ_DB_BUCKETS] = {",
+    ]
+    for i in range(0, len(seeds), 16):
+        lines.append("  " + ", ".join(str(s) for s in seeds[i:i + 16]) + ",")
+    lines += ["};", "", "static const micro_tz_db_entry micro_tz_db_entries[MICRO_TZ_DB_SIZE] = {"]
+    for name_offset, posix_offset, name in entries:
+        lines.append("  {%d, %d}, // %s" % (name_offset, posix_offset, name))
+    lines += ["};", "", "static const char micro_tz_db_pool[%d] =" % pool_size]
+    for s in pool:
+        lines.append("  " + c_string(s))
+    lines[-1] += ";"
+    lines.append("")
+
+    output = "\n".join(lines)
+    if os.path.exists(out_path):
+        with open(out_path) as f:
+            if f.read() == output:
+                return
+    with open(out_path, "w") as f:
+        f.write(output)
+    print("generate.py: wrote %s (%d bytes, was %d)" % (os.path.normpath(out_path), total, old_total))
+
+
+def main(root):
+    zones_dir = os.path.join(root, "lib", "Zones")
+    generate(os.path.join(zones_dir, "zones.csv"), os.path.join(zones_dir, "src", "zones_table.h"))
+
+
+try:
+    Import("env")  # noqa: F821, provided when PlatformIO runs this as an extra script
+    main(env.subst("$PROJECT_DIR"))  # noqa: F821
+except NameError:
+    main(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", ".."))
@@ -0,0 +1,64 @@
+#include "zones.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "zones_table.h"
+
+static char lower(char start) {
+  if ('A' <= start && start <= 'Z') {
+    return start - 'A' + 'a';
+  }
+  return start;
+}
+
+/**
+ * Steps to the next character of a name as it is normalized: lower case, with
+ * underscores after the first character skipped, since spaces have become
+ * underscores in some sources and not others.
+ * @param[in,out] name - the rest of the name, advanced past the character
+ * @return the normalized character, or 0 at the end of the name
+ **/
+static char next_normalized(const char **name) {
+  char c = *(*name)++;
+  while (**name == '_') {
+    (*name)++;
+  }
+  return lower(c);
+}
+
+static uint32_t mix(uint32_t h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+const char *micro_tz_db_get_posix_str(const char *name) {
+  if (!name || !*name) {
+    return NULL;
+  }
+
+  // FNV-1a over the normalized name picks a bucket, whose seed then picks the
+  // one entry the name can be
+  uint32_t h = MICRO_TZ_DB_FNV_OFFSET;
+  for (const char *p = name; *p;) {
+    h = (h ^ (uint8_t)next_normalized(&p)) * MICRO_TZ_DB_FNV_PRIME;
+  }
+  uint32_t seed = micro_tz_db_seeds[h % MICRO_TZ_DB_BUCKETS];
+  const micro_tz_db_entry *entry =
+      &micro_tz_db_entries[mix(h ^ (seed * MICRO_TZ_DB_SEED_MULT)) % MICRO_TZ_DB_SIZE];
+
+  // Names that aren't in the table hash somewhere too, so check it's this one
+  const char *stored = micro_tz_db_pool + entry->name;
+  const char *p = name;
+  while (*stored) {
+    if (!*p || next_normalized(&p) != *stored) {
+      return NULL;
+    }
+    stored++;
+  }
+  return *p ? NULL : micro_tz_db_pool + entry->posix_str;
+}
@@ -4,8 +4,10 @@
 
 /**
  * Looks up the POSIX string corresponding to the given tz database name
- * @param[in]   name   the tz database name for the timezone in question
- * @return             the POSIX string for the timezone in question
+ * @param[in]   name   the tz database name for the timezone in question, matched
+ *                     ignoring case and underscores after the first character
+ * @return             the POSIX string for the timezone in question, or NULL if
+ *                     there's no such zone
  **/
 #ifdef __cplusplus
 extern "C" {
@@ -0,0 +1,977 @@
+// Generated by lib/Zones/generate.py from lib/Zones/zones.csv, don't edit.
+// 425 zones, 94 distinct POSIX strings: 8446 bytes of strings, 1700 of entries
+// and 214 of seeds, 10360 in all (the sorted pointer table took 11910).
+#pragma once
+
+#include <stdint.h>
+
+#define MICRO_TZ_DB_SIZE 425
+#define MICRO_TZ_DB_BUCKETS 107
+#define MICRO_TZ_DB_FNV_OFFSET 0x811c9dc5u
+#define MICRO_TZ_DB_FNV_PRIME 0x01000193u
+#define MICRO_TZ_DB_SEED_MULT 0x9e3779b9u
+
+typedef struct {
+  // Offsets into micro_tz_db_pool of the normalized name and POSIX string
+  uint16_t name;
+  uint16_t posix_str;
+} micro_tz_db_entry;
+
+static const uint16_t micro_tz_db_seeds[MICRO_TZ_DB_BUCKETS] = {
+  26, 241, 9, 12, 4, 97, 135, 0, 20, 27, 31, 6, 137, 1, 13, 17,
+  6, 157, 54, 8, 5, 21, 15, 8, 83, 7, 9, 26, 116, 63, 3, 79,
+  60, 81, 12, 5, 2, 48, 116, 17, 28, 16, 168, 52, 14, 6, 37, 1264,
+  137, 5, 0, 0, 9, 0, 18, 0, 0, 4, 8, 271, 143, 3, 68, 415,
+  305, 1023, 22, 55, 31, 80, 4, 3, 0, 138, 31, 68, 191, 73, 356, 6,
+  269, 61, 5, 302, 70, 22, 520, 4, 510, 125, 388, 2209, 5, 396, 185, 6385,
+  2111, 21, 29, 64, 31, 739, 36, 77, 207, 6, 2,
+};
+
+static const micro_tz_db_entry micro_tz_db_entries[MICRO_TZ_DB_SIZE] = {
+  {0, 19}, // America/Kralendijk
+  {24, 40}, // Europe/Busingen
+  {67, 86}, // Australia/Lindeman
+  {94, 109}, // Asia/Vientiane
+  {117, 131}, // America/Boise
+  {154, 19}, // America/Blanc-Sablon
+  {175, 185}, // Asia/Omsk
+  {193, 212}, // Africa/Ouagadougou
+  {217, 40}, // Europe/Rome
+  {229, 40}, // Europe/Belgrade
+  {245, 269}, // America/Argentina/Jujuy
+  {276, 290}, // Africa/Harare
+  {296, 316}, // America/Dawson_Creek
+  {321, 348}, // America/North_Dakota/Center
+  {371, 86}, // Australia/Brisbane
+  {390, 402}, // Asia/Manila
+  {408, 109}, // Asia/Novokuznetsk
+  {426, 445}, // Australia/Lord_Howe
+  {482, 269}, // America/Santarem
+  {499, 131}, // America/Edmonton
+  {516, 529}, // Asia/Kolkata
+  {538, 348}, // America/Chicago
+  {554, 566}, // Asia/Taipei
+  {572, 587}, // Asia/Pyongyang
+  {593, 621}, // America/Kentucky/Louisville
+  {644, 348}, // America/Indiana/Knox
+  {665, 680}, // Europe/Tallinn
+  {709, 725}, // Asia/Choibalsan
+  {733, 131}, // America/Ojinaga
+  {749, 40}, // Europe/Zurich
+  {763, 316}, // America/Creston
+  {779, 796}, // America/Asuncion
+  {827, 840}, // Asia/Colombo
+  {853, 865}, // Asia/Tehran
+  {900, 916}, // Atlantic/Canary
+  {942, 959}, // America/Miquelon
+  {986, 212}, // Africa/Bissau
+  {1000, 1015}, // Asia/Kamchatka
+  {1024, 290}, // Africa/Bujumbura
+  {1041, 109}, // Asia/Hovd
+  {1051, 185}, // Antarctica/Vostok
+  {1069, 1085}, // Indian/Maldives
+  {1093, 1113}, // Pacific/Guadalcanal
+  {1122, 1137}, // America/Cayman
+  {1142, 1157}, // Africa/El_Aaiun
+  {1165, 1113}, // Antarctica/Casey
+  {1182, 1197}, // America/Regina
+  {1202, 1218}, // America/Noronha
+  {1225, 212}, // Atlantic/Reykjavik
+  {1244, 1257}, // Africa/Cairo
+  {1263, 1282}, // Atlantic/Cape_Verde
+  {1289, 290}, // Africa/Kigali
+  {1303, 1322}, // Africa/Dar_es_Salaam
+  {1328, 1340}, // Indian/Mahe
+  {1348, 1362}, // Pacific/Chuuk
+  {1371, 1340}, // Asia/Baku
+  {1381, 1015}, // Pacific/Funafuti
+  {1398, 1413}, // America/Juneau
+  {1438, 348}, // America/Resolute
+  {1455, 680}, // Asia/Famagusta
+  {1470, 348}, // America/Indiana/Tell_City
+  {1495, 1510}, // America/Bogota
+  {1517, 1533}, // Europe/Istanbul
+  {1541, 1510}, // America/Eirunepe
+  {1558, 269}, // Antarctica/Rothera
+  {1577, 1085}, // Asia/Oral
+  {1587, 40}, // Europe/Vaduz
+  {1600, 725}, // Asia/Brunei
+  {1612, 40}, // Arctic/Longyearbyen
+  {1632, 40}, // Europe/Vienna
+  {1646, 40}, // Europe/Podgorica
+  {1663, 1677}, // America/Thule
+  {1700, 1714}, // Africa/Luanda
+  {1720, 1510}, // America/Guayaquil
+  {1738, 269}, // America/Argentina/Catamarca
+  {1766, 1782}, // Pacific/Norfolk
+  {1813, 316}, // America/Hermosillo
+  {1832, 621}, // America/Indiana/Indianapolis
+  {1861, 1878}, // Australia/Sydney
+  {1907, 185}, // Asia/Dhaka
+  {1918, 1932}, // Asia/Jayapura
+  {1938, 316}, // America/Phoenix
+  {1954, 1113}, // Asia/Srednekolymsk
+  {1973, 1322}, // Africa/Djibouti
+  {1989, 2007}, // Pacific/Enderbury
+  {2016, 2035}, // Australia/Adelaide
+  {2066, 290}, // Africa/Lubumbashi
+  {2084, 1197}, // America/Tegucigalpa
+  {2104, 2007}, // Pacific/Tongatapu
+  {2122, 19}, // America/Barbados
+  {2139, 2158}, // America/Porto_Velho
+  {2165, 1322}, // Africa/Nairobi
+  {2180, 680}, // Europe/Uzhgorod
+  {2196, 621}, // America/Thunder_Bay
+  {2215, 1340}, // Indian/Mauritius
+  {2232, 212}, // America/Danmarkshavn
+  {2253, 2266}, // Africa/Tunis
+  {2272, 1085}, // Indian/Kerguelen
+  {2289, 2304}, // Asia/Jerusalem
+  {2331, 1015}, // Pacific/Nauru
+  {2345, 40}, // Europe/Gibraltar
+  {2362, 1510}, // America/Rio_Branco
+  {2380, 1015}, // Pacific/Kwajalein
+  {2398, 212}, // Atlantic/St_Helena
+  {2416, 1197}, // America/Guatemala
+  {2434, 621}, // America/Iqaluit
+  {2450, 2158}, // America/Guyana
+  {2465, 2483}, // America/Chihuahua
+  {2506, 1714}, // Africa/Niamey
+  {2520, 1340}, // Europe/Samara
+  {2534, 916}, // Atlantic/Faroe
+  {2549, 2568}, // America/Los_Angeles
+  {2591, 2610}, // Antarctica/McMurdo
+  {2638, 212}, // Africa/Accra
+  {2651, 1878}, // Australia/Hobart
+  {2668, 290}, // Africa/Khartoum
+  {2684, 1322}, // Africa/Kampala
+  {2699, 269}, // America/Punta_Arenas
+  {2719, 2736}, // Pacific/Pitcairn
+  {2743, 40}, // Europe/Madrid
+  {2757, 621}, // America/Nipigon
+  {2773, 212}, // Africa/Nouakchott
+  {2791, 1413}, // America/Metlakatla
+  {2810, 316}, // America/Fort_Nelson
+  {2829, 19}, // America/St_Kitts
+  {2845, 269}, // America/Belem
+  {2859, 131}, // America/Cambridge_Bay
+  {2880, 680}, // Europe/Zaporozhye
+  {2898, 2913}, // Asia/Kathmandu
+  {2926, 348}, // America/Menominee
+  {2944, 680}, // Asia/Nicosia
+  {2957, 212}, // Africa/Sao_Tome
+  {2972, 1322}, // Indian/Antananarivo
+  {2992, 916}, // Atlantic/Madeira
+  {3009, 621}, // America/Kentucky/Monticello
+  {3037, 109}, // Asia/Bangkok
+  {3050, 131}, // America/Inuvik
+  {3065, 19}, // America/St_Lucia
+  {3081, 1113}, // Pacific/Noumea
+  {3096, 621}, // America/Indiana/Vevay
+  {3118, 40}, // Africa/Ceuta
+  {3131, 725}, // Asia/Kuala_Lumpur
+  {3148, 269}, // America/Araguaina
+  {3166, 1510}, // America/Lima
+  {3179, 212}, // Africa/Banjul
+  {3193, 269}, // America/Argentina/Ushuaia
+  {3219, 1322}, // Indian/Mayotte
+  {3234, 1362}, // Antarctica/DumontDUrville
+  {3260, 1085}, // Asia/Atyrau
+  {3272, 3288}, // Australia/Perth
+  {3295, 109}, // Asia/Barnaul
+  {3308, 1085}, // Asia/Yekaterinburg
+  {3327, 212}, // Africa/Conakry
+  {3342, 3364}, // America/Bahia_Banderas
+  {3387, 1533}, // Europe/Minsk
+  {3400, 40}, // Europe/Warsaw
+  {3414, 19}, // America/Guadeloupe
+  {3433, 1340}, // Asia/Muscat
+  {3445, 1677}, // Atlantic/Bermuda
+  {3462, 269}, // America/Argentina/San_Juan
+  {3488, 3503}, // Pacific/Midway
+  {3509, 1218}, // Atlantic/South_Georgia
+  {3531, 290}, // Africa/Gaborone
+  {3547, 3559}, // Asia/Beirut
+  {3588, 3602}, // Europe/Dublin
+  {3629, 1340}, // Europe/Ulyanovsk
+  {3646, 109}, // Asia/Ho_Chi_Minh
+  {3661, 1714}, // Africa/Lagos
+  {3674, 40}, // Europe/Prague
+  {3688, 185}, // Asia/Urumqi
+  {3700, 19}, // America/Aruba
+  {3714, 1197}, // America/Belize
+  {3729, 1878}, // Australia/Melbourne
+  {3749, 2158}, // America/La_Paz
+  {3763, 40}, // Europe/Ljubljana
+  {3780, 3794}, // Africa/Maseru
+  {3801, 1137}, // America/Cancun
+  {3816, 1533}, // Asia/Riyadh
+  {3828, 40}, // Europe/Budapest
+  {3844, 1085}, // Asia/Aqtobe
+  {3856, 587}, // Asia/Seoul
+  {3867, 1413}, // America/Anchorage
+  {3885, 1137}, // America/Atikokan
+  {3902, 19}, // America/Marigot
+  {3918, 1533}, // Asia/Qatar
+  {3929, 1533}, // Asia/Bahrain
+  {3942, 269}, // America/Maceio
+  {3957, 1113}, // Pacific/Bougainville
+  {3978, 916}, // Europe/Lisbon
+  {3992, 2158}, // America/Cuiaba
+  {4007, 1714}, // Africa/Libreville
+  {4025, 185}, // Asia/Bishkek
+  {4038, 1257}, // Africa/Tripoli
+  {4053, 1085}, // Asia/Tashkent
+  {4067, 1362}, // Asia/Ust-Nera
+  {4081, 1533}, // Asia/Aden
+  {4091, 1533}, // Europe/Kirov
+  {4104, 1413}, // America/Sitka
+  {4118, 1677}, // America/Halifax
+  {4134, 212}, // Africa/Monrovia
+  {4150, 1085}, // Asia/Aqtau
+  {4161, 212}, // Africa/Dakar
+  {4174, 621}, // America/Montreal
+  {4191, 2035}, // Australia/Broken_Hill
+  {4212, 4229}, // Australia/Darwin
+  {4239, 269}, // America/Argentina/Salta
+  {4263, 4277}, // Europe/Jersey
+  {4302, 621}, // America/Indiana/Vincennes
+  {4328, 269}, // America/Argentina/Cordoba
+  {4354, 4364}, // Asia/Gaza
+  {4394, 269}, // America/Argentina/San_Luis
+  {4420, 1340}, // Europe/Saratov
+  {4435, 1533}, // Asia/Baghdad
+  {4448, 566}, // Asia/Shanghai
+  {4462, 1413}, // America/Yakutat
+  {4478, 1340}, // Indian/Reunion
+  {4493, 566}, // Asia/Macau
+  {4504, 1340}, // Asia/Yerevan
+  {4517, 1197}, // America/Costa_Rica
+  {4535, 4554}, // Pacific/Kiritimati
+  {4563, 40}, // Europe/Sarajevo
+  {4579, 269}, // Antarctica/Palmer
+  {4597, 109}, // Asia/Phnom_Penh
+  {4612, 40}, // Europe/Andorra
+  {4627, 19}, // America/Montserrat
+  {4646, 1322}, // Indian/Comoro
+  {4660, 4673}, // Pacific/Guam
+  {4681, 4699}, // Pacific/Marquesas
+  {4711, 725}, // Asia/Singapore
+  {4726, 4739}, // Asia/Yakutsk
+  {4747, 109}, // Indian/Christmas
+  {4764, 1714}, // Africa/Brazzaville
+  {4783, 40}, // Europe/Tirane
+  {4797, 1322}, // Africa/Asmara
+  {4811, 4824}, // Indian/Cocos
+  {4837, 4850}, // Asia/Karachi
+  {4856, 4873}, // Pacific/Honolulu
+  {4879, 3364}, // America/Monterrey
+  {4897, 1362}, // Pacific/Port_Moresby
+  {4917, 269}, // America/Cayenne
+  {4933, 621}, // America/Nassau
+  {4948, 1533}, // Antarctica/Syowa
+  {4965, 40}, // Europe/Berlin
+  {4979, 2568}, // America/Tijuana
+  {4995, 621}, // America/Indiana/Petersburg
+  {5022, 269}, // America/Montevideo
+  {5041, 725}, // Asia/Ulaanbaatar
+  {5058, 185}, // Asia/Thimphu
+  {5071, 680}, // Europe/Vilnius
+  {5086, 1714}, // Africa/Bangui
+  {5100, 1085}, // Antarctica/Mawson
+  {5118, 5136}, // Pacific/Rarotonga
+  {5144, 40}, // Europe/Malta
+  {5157, 621}, // America/New_York
+  {5173, 3364}, // America/Mexico_City
+  {5192, 19}, // America/Martinique
+  {5211, 290}, // Africa/Windhoek
+  {5227, 4739}, // Asia/Dili
+  {5237, 1085}, // Asia/Ashgabat
+  {5251, 19}, // America/St_Vincent
+  {5269, 19}, // America/St_Thomas
+  {5286, 1677}, // America/Goose_Bay
+  {5303, 1113}, // Pacific/Pohnpei
+  {5319, 5136}, // Pacific/Tahiti
+  {5334, 40}, // Europe/Amsterdam
+  {5351, 109}, // Asia/Novosibirsk
+  {5368, 185}, // Indian/Chagos
+  {5382, 2158}, // America/Manaus
+  {5397, 5413}, // America/St_Johns
+  {5439, 5452}, // Pacific/Fiji
+  {5484, 680}, // Europe/Sofia
+  {5497, 316}, // America/Whitehorse
+  {5516, 212}, // Africa/Bamako
+  {5530, 5543}, // Pacific/Niue
+  {5551, 2158}, // America/Caracas
+  {5567, 1137}, // America/Panama
+  {5582, 2568}, // America/Vancouver
+  {5600, 269}, // America/Sao_Paulo
+  {5617, 1878}, // Australia/Currie
+  {5634, 5649}, // America/Havana
+  {5676, 4277}, // Europe/London
+  {5690, 1197}, // America/Swift_Current
+  {5711, 5727}, // Atlantic/Azores
+  {5758, 3794}, // Africa/Mbabane
+  {5773, 269}, // America/Fortaleza
+  {5791, 5807}, // Pacific/Gambier
+  {5814, 5828}, // Asia/Makassar
+  {5835, 19}, // America/Grenada
+  {5851, 680}, // Europe/Kiev
+  {5863, 4739}, // Pacific/Palau
+  {5877, 290}, // Africa/Blantyre
+  {5893, 1085}, // Asia/Samarkand
+  {5908, 316}, // America/Dawson
+  {5923, 1714}, // Africa/Kinshasa
+  {5939, 348}, // America/North_Dakota/New_Salem
+  {5968, 5983}, // Asia/Pontianak
+  {5989, 1197}, // America/Managua
+  {6005, 1714}, // Africa/Ndjamena
+  {6021, 40}, // Europe/Zagreb
+  {6035, 1257}, // Europe/Kaliningrad
+  {6054, 269}, // America/Argentina/La_Rioja
+  {6080, 109}, // Antarctica/Davis
+  {6097, 2158}, // America/Campo_Grande
+  {6117, 1015}, // Pacific/Majuro
+  {6132, 6149}, // America/Santiago
+  {6181, 680}, // Europe/Mariehamn
+  {6198, 1113}, // Asia/Sakhalin
+  {6212, 1533}, // Europe/Volgograd
+  {6229, 1362}, // Asia/Vladivostok
+  {6246, 6260}, // Asia/Damascus
+  {6289, 6300}, // Asia/Amman
+  {6330, 19}, // America/Santo_Domingo
+  {6351, 6367}, // Pacific/Chatham
+  {6412, 1322}, // Africa/Addis_Ababa
+  {6430, 2158}, // America/Boa_Vista
+  {6447, 1714}, // Africa/Douala
+  {6461, 1085}, // Asia/Dushanbe
+  {6475, 2007}, // Pacific/Apia
+  {6488, 290}, // Africa/Juba
+  {6500, 19}, // America/Antigua
+  {6516, 40}, // Europe/Paris
+  {6529, 725}, // Asia/Irkutsk
+  {6542, 4673}, // Pacific/Saipan
+  {6557, 19}, // America/Tortola
+  {6573, 6589}, // Australia/Eucla
+  {6602, 3364}, // America/Merida
+  {6617, 269}, // America/Bahia
+  {6631, 1322}, // Africa/Mogadishu
+  {6648, 1015}, // Asia/Anadyr
+  {6660, 3794}, // Africa/Johannesburg
+  {6680, 4277}, // Europe/Guernsey
+  {6696, 621}, // America/Grand_Turk
+  {6714, 1677}, // America/Moncton
+  {6730, 269}, // America/Recife
+  {6745, 269}, // America/Argentina/Rio_Gallegos
+  {6775, 109}, // Asia/Krasnoyarsk
+  {6792, 2483}, // America/Mazatlan
+  {6809, 40}, // Europe/Skopje
+  {6823, 6839}, // America/Godthab
+  {6872, 19}, // America/Curacao
+  {6888, 212}, // Africa/Lome
+  {6900, 725}, // Asia/Kuching
+  {6913, 2007}, // Pacific/Fakaofo
+  {6929, 6944}, // Pacific/Easter
+  {6976, 1085}, // Asia/Qyzylorda
+  {6991, 40}, // Europe/Oslo
+  {7003, 19}, // America/Lower_Princes
+  {7024, 7035}, // Asia/Kabul
+  {7048, 290}, // Africa/Lusaka
+  {7062, 109}, // Asia/Tomsk
+  {7073, 1197}, // America/El_Salvador
+  {7092, 1677}, // America/Glace_Bay
+  {7109, 1878}, // Antarctica/Macquarie
+  {7130, 19}, // America/Port_of_Spain
+  {7150, 680}, // Europe/Athens
+  {7164, 185}, // Asia/Almaty
+  {7176, 269}, // America/Argentina/Tucuman
+  {7202, 1714}, // Africa/Malabo
+  {7216, 621}, // America/Indiana/Marengo
+  {7240, 348}, // America/Matamoros
+  {7258, 269}, // America/Argentina/Mendoza
+  {7284, 621}, // America/Pangnirtung
+  {7304, 290}, // Africa/Maputo
+  {7318, 7332}, // Europe/Moscow
+  {7338, 621}, // America/Indiana/Winamac
+  {7362, 348}, // America/Rainy_River
+  {7381, 19}, // America/Dominica
+  {7398, 1113}, // Asia/Magadan
+  {7411, 1157}, // Africa/Casablanca
+  {7429, 19}, // America/Anguilla
+  {7446, 7464}, // Pacific/Galapagos
+  {7471, 1413}, // America/Nome
+  {7484, 269}, // America/Argentina/Buenos_Aires
+  {7514, 7332}, // Europe/Simferopol
+  {7532, 4739}, // Asia/Chita
+  {7543, 131}, // America/Yellowknife
+  {7563, 4277}, // Europe/Isle_of_Man
+  {7580, 5983}, // Asia/Jakarta
+  {7593, 212}, // Africa/Abidjan
+  {7608, 4824}, // Asia/Yangon
+  {7620, 621}, // America/Detroit
+  {7636, 348}, // America/North_Dakota/Beulah
+  {7663, 7680}, // Antarctica/Troll
+  {7713, 348}, // America/Rankin_Inlet
+  {7733, 40}, // Europe/Bratislava
+  {7751, 212}, // Africa/Freetown
+  {7767, 680}, // Europe/Bucharest
+  {7784, 621}, // America/Port-au-Prince
+  {7807, 7823}, // Europe/Chisinau
+  {7850, 680}, // Europe/Helsinki
+  {7866, 19}, // America/St_Barthelemy
+  {7887, 5727}, // America/Scoresbysund
+  {7908, 1015}, // Pacific/Tarawa
+  {7923, 40}, // Europe/Luxembourg
+  {7941, 4364}, // Asia/Hebron
+  {7953, 7967}, // Asia/Hong_Kong
+  {7973, 1113}, // Pacific/Efate
+  {7987, 40}, // Europe/Brussels
+  {8003, 269}, // Atlantic/Stanley
+  {8020, 621}, // America/Toronto
+  {8036, 3503}, // Pacific/Pago_Pago
+  {8053, 40}, // Europe/Monaco
+  {8067, 40}, // Europe/Vatican
+  {8082, 1015}, // Pacific/Wake
+  {8095, 1533}, // Asia/Kuwait
+  {8107, 1340}, // Asia/Tbilisi
+  {8120, 1340}, // Asia/Dubai
+  {8131, 131}, // America/Denver
+  {8146, 1137}, // America/Jamaica
+  {8162, 8175}, // America/Adak
+  {8199, 2266}, // Africa/Algiers
+  {8214, 1340}, // Europe/Astrakhan
+  {8231, 680}, // Europe/Riga
+  {8243, 4739}, // Asia/Khandyga
+  {8257, 1015}, // Pacific/Wallis
+  {8272, 269}, // America/Paramaribo
+  {8291, 8302}, // Asia/Tokyo
+  {8308, 2610}, // Pacific/Auckland
+  {8325, 40}, // Europe/Copenhagen
+  {8343, 19}, // America/Puerto_Rico
+  {8362, 40}, // Europe/Stockholm
+  {8379, 348}, // America/Winnipeg
+  {8396, 1113}, // Pacific/Kosrae
+  {8411, 40}, // Europe/San_Marino
+  {8428, 1714}, // Africa/Porto-Novo
+};
+
+static const char micro_tz_db_pool[8446] =
+  "america/kralendijk\0"
+  "AST4\0"
+  "europe/busingen\0"
+  "CET-1CEST,M3.5.0,M10.5.0/3\0"
+  "australia/lindeman\0"
+  "AEST-10\0"
+  "asia/vientiane\0"
+  "<+07>-7\0"
+  "america/boise\0"
+  "MST7MDT,M3.2.0,M11.1.0\0"
+  "america/blanc-sablon\0"
+  "asia/omsk\0"
+  "<+06>-6\0"
+  "africa/ouagadougou\0"
+  "GMT0\0"
+  "europe/rome\0"
+  "europe/belgrade\0"
+  "america/argentina/jujuy\0"
+  "<-03>3\0"
+  "africa/harare\0"
+  "CAT-2\0"
+  "america/dawsoncreek\0"
+  "MST7\0"
+  "america/northdakota/center\0"
+  "CST6CDT,M3.2.0,M11.1.0\0"
+  "australia/brisbane\0"
+  "asia/manila\0"
+  "PST-8\0"
+  "asia/novokuznetsk\0"
+  "australia/lordhowe\0"
+  "<+1030>-10:30<+11>-11,M10.1.0,M4.1.0\0"
+  "america/santarem\0"
+  "america/edmonton\0"
+  "asia/kolkata\0"
+  "IST-5:30\0"
+  "america/chicago\0"
+  "asia/taipei\0"
+  "CST-8\0"
+  "asia/pyongyang\0"
+  "KST-9\0"
+  "america/kentucky/louisville\0"
+  "EST5EDT,M3.2.0,M11.1.0\0"
+  "america/indiana/knox\0"
+  "europe/tallinn\0"
+  "EET-2EEST,M3.5.0/3,M10.5.0/4\0"
+  "asia/choibalsan\0"
+  "<+08>-8\0"
+  "america/ojinaga\0"
+  "europe/zurich\0"
+  "america/creston\0"
+  "america/asuncion\0"
+  "<-04>4<-03>,M10.1.0/0,M3.4.0/0\0"
+  "asia/colombo\0"
+  "<+0530>-5:30\0"
+  "asia/tehran\0"
+  "<+0330>-3:30<+0430>,J79/24,J263/24\0"
+  "atlantic/canary\0"
+  "WET0WEST,M3.5.0/1,M10.5.0\0"
+  "america/miquelon\0"
+  "<-03>3<-02>,M3.2.0,M11.1.0\0"
+  "africa/bissau\0"
+  "asia/kamchatka\0"
+  "<+12>-12\0"
+  "africa/bujumbura\0"
+  "asia/hovd\0"
+  "antarctica/vostok\0"
+  "indian/maldives\0"
+  "<+05>-5\0"
+  "pacific/guadalcanal\0"
+  "<+11>-11\0"
+  "america/cayman\0"
+  "EST5\0"
+  "africa/elaaiun\0"
+  "<+01>-1\0"
+  "antarctica/casey\0"
+  "america/regina\0"
+  "CST6\0"
+  "america/noronha\0"
+  "<-02>2\0"
+  "atlantic/reykjavik\0"
+  "africa/cairo\0"
+  "EET-2\0"
+  "atlantic/capeverde\0"
+  "<-01>1\0"
+  "africa/kigali\0"
+  "africa/daressalaam\0"
+  "EAT-3\0"
+  "indian/mahe\0"
+  "<+04>-4\0"
+  "pacific/chuuk\0"
+  "<+10>-10\0"
+  "asia/baku\0"
+  "pacific/funafuti\0"
+  "america/juneau\0"
+  "AKST9AKDT,M3.2.0,M11.1.0\0"
+  "america/resolute\0"
+  "asia/famagusta\0"
+  "america/indiana/tellcity\0"
+  "america/bogota\0"
+  "<-05>5\0"
+  "europe/istanbul\0"
+  "<+03>-3\0"
+  "america/eirunepe\0"
+  "antarctica/rothera\0"
+  "asia/oral\0"
+  "europe/vaduz\0"
+  "asia/brunei\0"
+  "arctic/longyearbyen\0"
+  "europe/vienna\0"
+  "europe/podgorica\0"
+  "america/thule\0"
+  "AST4ADT,M3.2.0,M11.1.0\0"
+  "africa/luanda\0"
+  "WAT-1\0"
+  "america/guayaquil\0"
+  "america/argentina/catamarca\0"
+  "pacific/norfolk\0"
+  "<+11>-11<+12>,M10.1.0,M4.1.0/3\0"
+  "america/hermosillo\0"
+  "america/indiana/indianapolis\0"
+  "australia/sydney\0"
+  "AEST-10AEDT,M10.1.0,M4.1.0/3\0"
+  "asia/dhaka\0"
+  "asia/jayapura\0"
+  "WIT-9\0"
+  "america/phoenix\0"
+  "asia/srednekolymsk\0"
+  "africa/djibouti\0"
+  "pacific/enderbury\0"
+  "<+13>-13\0"
+  "australia/adelaide\0"
+  "ACST-9:30ACDT,M10.1.0,M4.1.0/3\0"
+  "africa/lubumbashi\0"
+  "america/tegucigalpa\0"
+  "pacific/tongatapu\0"
+  "america/barbados\0"
+  "america/portovelho\0"
+  "<-04>4\0"
+  "africa/nairobi\0"
+  "europe/uzhgorod\0"
+  "america/thunderbay\0"
+  "indian/mauritius\0"
+  "america/danmarkshavn\0"
+  "africa/tunis\0"
+  "CET-1\0"
+  "indian/kerguelen\0"
+  "asia/jerusalem\0"
+  "IST-2IDT,M3.4.4/26,M10.5.0\0"
+  "pacific/nauru\0"
+  "europe/gibraltar\0"
+  "america/riobranco\0"
+  "pacific/kwajalein\0"
+  "atlantic/sthelena\0"
+  "america/guatemala\0"
+  "america/iqaluit\0"
+  "america/guyana\0"
+  "america/chihuahua\0"
+  "MST7MDT,M4.1.0,M10.5.0\0"
+  "africa/niamey\0"
+  "europe/samara\0"
+  "atlantic/faroe\0"
+  "america/losangeles\0"
+  "PST8PDT,M3.2.0,M11.1.0\0"
+  "antarctica/mcmurdo\0"
+  "NZST-12NZDT,M9.5.0,M4.1.0/3\0"
+  "africa/accra\0"
+  "australia/hobart\0"
+  "africa/khartoum\0"
+  "africa/kampala\0"
+  "america/puntaarenas\0"
+  "pacific/pitcairn\0"
+  "<-08>8\0"
+  "europe/madrid\0"
+  "america/nipigon\0"
+  "africa/nouakchott\0"
+  "america/metlakatla\0"
+  "america/fortnelson\0"
+  "america/stkitts\0"
+  "america/belem\0"
+  "america/cambridgebay\0"
+  "europe/zaporozhye\0"
+  "asia/kathmandu\0"
+  "<+0545>-5:45\0"
+  "america/menominee\0"
+  "asia/nicosia\0"
+  "africa/saotome\0"
+  "indian/antananarivo\0"
+  "atlantic/madeira\0"
+  "america/kentucky/monticello\0"
+  "asia/bangkok\0"
+  "america/inuvik\0"
+  "america/stlucia\0"
+  "pacific/noumea\0"
+  "america/indiana/vevay\0"
+  "africa/ceuta\0"
+  "asia/kualalumpur\0"
+  "america/araguaina\0"
+  "america/lima\0"
+  "africa/banjul\0"
+  "america/argentina/ushuaia\0"
+  "indian/mayotte\0"
+  "antarctica/dumontdurville\0"
+  "asia/atyrau\0"
+  "australia/perth\0"
+  "AWST-8\0"
+  "asia/barnaul\0"
+  "asia/yekaterinburg\0"
+  "africa/conakry\0"
+  "america/bahiabanderas\0"
+  "CST6CDT,M4.1.0,M10.5.0\0"
+  "europe/minsk\0"
+  "europe/warsaw\0"
+  "america/guadeloupe\0"
+  "asia/muscat\0"
+  "atlantic/bermuda\0"
+  "america/argentina/sanjuan\0"
+  "pacific/midway\0"
+  "SST11\0"
+  "atlantic/southgeorgia\0"
+  "africa/gaborone\0"
+  "asia/beirut\0"
+  "EET-2EEST,M3.5.0/0,M10.5.0/0\0"
+  "europe/dublin\0"
+  "IST-1GMT0,M10.5.0,M3.5.0/1\0"
+  "europe/ulyanovsk\0"
+  "asia/hochiminh\0"
+  "africa/lagos\0"
+  "europe/prague\0"
+  "asia/urumqi\0"
+  "america/aruba\0"
+  "america/belize\0"
+  "australia/melbourne\0"
+  "america/lapaz\0"
+  "europe/ljubljana\0"
+  "africa/maseru\0"
+  "SAST-2\0"
+  "america/cancun\0"
+  "asia/riyadh\0"
+  "europe/budapest\0"
+  "asia/aqtobe\0"
+  "asia/seoul\0"
+  "america/anchorage\0"
+  "america/atikokan\0"
+  "america/marigot\0"
+  "asia/qatar\0"
+  "asia/bahrain\0"
+  "america/maceio\0"
+  "pacific/bougainville\0"
+  "europe/lisbon\0"
+  "america/cuiaba\0"
+  "africa/libreville\0"
+  "asia/bishkek\0"
+  "africa/tripoli\0"
+  "asia/tashkent\0"
+  "asia/ust-nera\0"
+  "asia/aden\0"
+  "europe/kirov\0"
+  "america/sitka\0"
+  "america/halifax\0"
+  "africa/monrovia\0"
+  "asia/aqtau\0"
+  "africa/dakar\0"
+  "america/montreal\0"
+  "australia/brokenhill\0"
+  "australia/darwin\0"
+  "ACST-9:30\0"
+  "america/argentina/salta\0"
+  "europe/jersey\0"
+  "GMT0BST,M3.5.0/1,M10.5.0\0"
+  "america/indiana/vincennes\0"
+  "america/argentina/cordoba\0"
+  "asia/gaza\0"
+  "EET-2EEST,M3.4.4/48,M10.5.5/1\0"
+  "america/argentina/sanluis\0"
+  "europe/saratov\0"
+  "asia/baghdad\0"
+  "asia/shanghai\0"
+  "america/yakutat\0"
+  "indian/reunion\0"
+  "asia/macau\0"
+  "asia/yerevan\0"
+  "america/costarica\0"
+  "pacific/kiritimati\0"
+  "<+14>-14\0"
+  "europe/sarajevo\0"
+  "antarctica/palmer\0"
+  "asia/phnompenh\0"
+  "europe/andorra\0"
+  "america/montserrat\0"
+  "indian/comoro\0"
+  "pacific/guam\0"
+  "ChST-10\0"
+  "pacific/marquesas\0"
+  "<-0930>9:30\0"
+  "asia/singapore\0"
+  "asia/yakutsk\0"
+  "<+09>-9\0"
+  "indian/christmas\0"
+  "africa/brazzaville\0"
+  "europe/tirane\0"
+  "africa/asmara\0"
+  "indian/cocos\0"
+  "<+0630>-6:30\0"
+  "asia/karachi\0"
+  "PKT-5\0"
+  "pacific/honolulu\0"
+  "HST10\0"
+  "america/monterrey\0"
+  "pacific/portmoresby\0"
+  "america/cayenne\0"
+  "america/nassau\0"
+  "antarctica/syowa\0"
+  "europe/berlin\0"
+  "america/tijuana\0"
+  "america/indiana/petersburg\0"
+  "america/montevideo\0"
+  "asia/ulaanbaatar\0"
+  "asia/thimphu\0"
+  "europe/vilnius\0"
+  "africa/bangui\0"
+  "antarctica/mawson\0"
+  "pacific/rarotonga\0"
+  "<-10>10\0"
+  "europe/malta\0"
+  "america/newyork\0"
+  "america/mexicocity\0"
+  "america/martinique\0"
+  "africa/windhoek\0"
+  "asia/dili\0"
+  "asia/ashgabat\0"
+  "america/stvincent\0"
+  "america/stthomas\0"
+  "america/goosebay\0"
+  "pacific/pohnpei\0"
+  "pacific/tahiti\0"
+  "europe/amsterdam\0"
+  "asia/novosibirsk\0"
+  "indian/chagos\0"
+  "america/manaus\0"
+  "america/stjohns\0"
+  "NST3:30NDT,M3.2.0,M11.1.0\0"
+  "pacific/fiji\0"
+  "<+12>-12<+13>,M11.2.0,M1.2.3/99\0"
+  "europe/sofia\0"
+  "america/whitehorse\0"
+  "africa/bamako\0"
+  "pacific/niue\0"
+  "<-11>11\0"
+  "america/caracas\0"
+  "america/panama\0"
+  "america/vancouver\0"
+  "america/saopaulo\0"
+  "australia/currie\0"
+  "america/havana\0"
+  "CST5CDT,M3.2.0/0,M11.1.0/1\0"
+  "europe/london\0"
+  "america/swiftcurrent\0"
+  "atlantic/azores\0"
+  "<-01>1<+00>,M3.5.0/0,M10.5.0/1\0"
+  "africa/mbabane\0"
+  "america/fortaleza\0"
+  "pacific/gambier\0"
+  "<-09>9\0"
+  "asia/makassar\0"
+  "WITA-8\0"
+  "america/grenada\0"
+  "europe/kiev\0"
+  "pacific/palau\0"
+  "africa/blantyre\0"
+  "asia/samarkand\0"
+  "america/dawson\0"
+  "africa/kinshasa\0"
+  "america/northdakota/newsalem\0"
+  "asia/pontianak\0"
+  "WIB-7\0"
+  "america/managua\0"
+  "africa/ndjamena\0"
+  "europe/zagreb\0"
+  "europe/kaliningrad\0"
+  "america/argentina/larioja\0"
+  "antarctica/davis\0"
+  "america/campogrande\0"
+  "pacific/majuro\0"
+  "america/santiago\0"
+  "<-04>4<-03>,M9.1.6/24,M4.1.6/24\0"
+  "europe/mariehamn\0"
+  "asia/sakhalin\0"
+  "europe/volgograd\0"
+  "asia/vladivostok\0"
+  "asia/damascus\0"
+  "EET-2EEST,M3.5.5/0,M10.5.5/0\0"
+  "asia/amman\0"
+  "EET-2EEST,M2.5.4/24,M10.5.5/1\0"
+  "america/santodomingo\0"
+  "pacific/chatham\0"
+  "<+1245>-12:45<+1345>,M9.5.0/2:45,M4.1.0/3:45\0"
+  "africa/addisababa\0"
+  "america/boavista\0"
+  "africa/douala\0"
+  "asia/dushanbe\0"
+  "pacific/apia\0"
+  "africa/juba\0"
+  "america/antigua\0"
+  "europe/paris\0"
+  "asia/irkutsk\0"
+  "pacific/saipan\0"
+  "america/tortola\0"
+  "australia/eucla\0"
+  "<+0845>-8:45\0"
+  "america/merida\0"
+  "america/bahia\0"
+  "africa/mogadishu\0"
+  "asia/anadyr\0"
+  "africa/johannesburg\0"
+  "europe/guernsey\0"
+  "america/grandturk\0"
+  "america/moncton\0"
+  "america/recife\0"
+  "america/argentina/riogallegos\0"
+  "asia/krasnoyarsk\0"
+  "america/mazatlan\0"
+  "europe/skopje\0"
+  "america/godthab\0"
+  "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1\0"
+  "america/curacao\0"
+  "africa/lome\0"
+  "asia/kuching\0"
+  "pacific/fakaofo\0"
+  "pacific/easter\0"
+  "<-06>6<-05>,M9.1.6/22,M4.1.6/22\0"
+  "asia/qyzylorda\0"
+  "europe/oslo\0"
+  "america/lowerprinces\0"
+  "asia/kabul\0"
+  "<+0430>-4:30\0"
+  "africa/lusaka\0"
+  "asia/tomsk\0"
+  "america/elsalvador\0"
+  "america/glacebay\0"
+  "antarctica/macquarie\0"
+  "america/portofspain\0"
+  "europe/athens\0"
+  "asia/almaty\0"
+  "america/argentina/tucuman\0"
+  "africa/malabo\0"
+  "america/indiana/marengo\0"
+  "america/matamoros\0"
+  "america/argentina/mendoza\0"
+  "america/pangnirtung\0"
+  "africa/maputo\0"
+  "europe/moscow\0"
+  "MSK-3\0"
+  "america/indiana/winamac\0"
+  "america/rainyriver\0"
+  "america/dominica\0"
+  "asia/magadan\0"
+  "africa/casablanca\0"
+  "america/anguilla\0"
+  "pacific/galapagos\0"
+  "<-06>6\0"
+  "america/nome\0"
+  "america/argentina/buenosaires\0"
+  "europe/simferopol\0"
+  "asia/chita\0"
+  "america/yellowknife\0"
+  "europe/isleofman\0"
+  "asia/jakarta\0"
+  "africa/abidjan\0"
+  "asia/yangon\0"
+  "america/detroit\0"
+  "america/northdakota/beulah\0"
+  "antarctica/troll\0"
+  "<+00>0<+02>-2,M3.5.0/1,M10.5.0/3\0"
+  "america/rankininlet\0"
+  "europe/bratislava\0"
+  "africa/freetown\0"
+  "europe/bucharest\0"
+  "america/port-au-prince\0"
+  "europe/chisinau\0"
+  "EET-2EEST,M3.5.0,M10.5.0/3\0"
+  "europe/helsinki\0"
+  "america/stbarthelemy\0"
+  "america/scoresbysund\0"
+  "pacific/tarawa\0"
+  "europe/luxembourg\0"
+  "asia/hebron\0"
+  "asia/hongkong\0"
+  "HKT-8\0"
+  "pacific/efate\0"
+  "europe/brussels\0"
+  "atlantic/stanley\0"
+  "america/toronto\0"
+  "pacific/pagopago\0"
+  "europe/monaco\0"
+  "europe/vatican\0"
+  "pacific/wake\0"
+  "asia/kuwait\0"
+  "asia/tbilisi\0"
+  "asia/dubai\0"
+  "america/denver\0"
+  "america/jamaica\0"
+  "america/adak\0"
+  "HST10HDT,M3.2.0,M11.1.0\0"
+  "africa/algiers\0"
+  "europe/astrakhan\0"
+  "europe/riga\0"
+  "asia/khandyga\0"
+  "pacific/wallis\0"
+  "america/paramaribo\0"
+  "asia/tokyo\0"
+  "JST-9\0"
+  "pacific/auckland\0"
+  "europe/copenhagen\0"
+  "america/puertorico\0"
+  "europe/stockholm\0"
+  "america/winnipeg\0"
+  "pacific/kosrae\0"
+  "europe/sanmarino\0"
+  "africa/porto-novo\0";
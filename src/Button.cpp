@@ -1,5 +1,6 @@
 #include "Button.h"
 
+#include "events.h"
 #include "helpers.h"
 
 static void globalOnInterrupt(void *arg) { ((Button *)arg)->onInterrupt(); }
@@ -11,13 +12,15 @@ void Button::setup(bool start_pressed) {
                         .pull_down_en = GPIO_PULLDOWN_DISABLE,
                         .intr_type = GPIO_INTR_DISABLE};
   ESP_ERROR_CHECK(gpio_config(&conf));
-  ESP_ERROR_CHECK(gpio_isr_register(globalOnInterrupt, this, 0, NULL));
+  // Requires gpio_install_isr_service to have been called
+  ESP_ERROR_CHECK(gpio_isr_handler_add(pin_, globalOnInterrupt, this));
 
   // TODO: Verify behavior if we start up with the button pressed
   setState(start_pressed ? State::PRESS_DEBOUNCE : State::RELEASED);
 };
 
-// NB: This currently assumes it will be called quite frequently
+// Should be called after the button posts EVENT_BUTTON and again once
+// nextUpdateMillis() passes.
 Button::CallbackReason Button::poll() {
   CallbackReason reason = CallbackReason::NONE;
 
@@ -142,4 +145,5 @@ void Button::onInterrupt() {
     ESP_ERROR_CHECK(gpio_intr_disable(pin_));
     release_start_ = true;
   }
+  events_post_from_isr(EVENT_BUTTON);
 }
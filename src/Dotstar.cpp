@@ -1,30 +1,25 @@
 #include "Dotstar.h"
 
+#include <algorithm>
+#include <string.h>
+
 #include "driver/rtc_io.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include <esp_timer.h>
+#include "esp_attr.h"
+
+#include "helpers.h"
 
 #define DOTSTAR_CLK GPIO_NUM_12
 #define DOTSTAR_DATA GPIO_NUM_2
 #define DOTSTAR_PWR GPIO_NUM_13
 
-// Copied from Arduino HAL code
-#define NOP() asm volatile("nop")
-void delay_microseconds(uint32_t us) {
-  uint64_t m = (uint64_t)esp_timer_get_time();
-  if (us) {
-    uint64_t e = (m + us);
-    if (m > e) { //overflow
-      while ((uint64_t)esp_timer_get_time() > e) {
-        NOP();
-      }
-    }
-    while ((uint64_t)esp_timer_get_time() < e) {
-      NOP();
-    }
-  }
-}
+#define DOTSTAR_SPI_HOST SPI2_HOST
+#define DOTSTAR_SPI_HZ 4000000
+// How long the LED needs after power on before it accepts a frame
+#define DOTSTAR_POWER_ON_MS 10
+
+// Start frame, one pixel and the end frame
+#define DOTSTAR_FRAME_SIZE 9
+DMA_ATTR static uint8_t s_frame[DOTSTAR_FRAME_SIZE];
 
 void Dotstar::setPower(bool state) {
   if (state == state_) {
@@ -36,22 +31,44 @@ void Dotstar::setPower(bool state) {
   gpio_config_t gpio_pwr_cfg{};
   gpio_pwr_cfg.mode = state ? GPIO_MODE_OUTPUT : GPIO_MODE_INPUT;
   gpio_pwr_cfg.pin_bit_mask = (1ULL << DOTSTAR_PWR);
-
-  gpio_config_t gpio_spi_cfg = gpio_pwr_cfg;
-  gpio_spi_cfg.pin_bit_mask = ((1ULL << DOTSTAR_DATA) | (1ULL << DOTSTAR_CLK));
-
-  if (!state) {
-    gpio_spi_cfg.pull_down_en = GPIO_PULLDOWN_ENABLE;
-  }
-
   ESP_ERROR_CHECK(gpio_config(&gpio_pwr_cfg));
-  ESP_ERROR_CHECK(gpio_config(&gpio_spi_cfg));
 
   if (state) {
     ESP_ERROR_CHECK(gpio_set_level(DOTSTAR_PWR, 0));
-    ESP_ERROR_CHECK(gpio_set_level(DOTSTAR_DATA, 0));
-    ESP_ERROR_CHECK(gpio_set_level(DOTSTAR_CLK, 0));
+
+    spi_bus_config_t bus_cfg{};
+    bus_cfg.mosi_io_num = DOTSTAR_DATA;
+    bus_cfg.miso_io_num = -1;
+    bus_cfg.sclk_io_num = DOTSTAR_CLK;
+    bus_cfg.quadwp_io_num = -1;
+    bus_cfg.quadhd_io_num = -1;
+    bus_cfg.max_transfer_sz = DOTSTAR_FRAME_SIZE;
+    ESP_ERROR_CHECK(spi_bus_initialize(DOTSTAR_SPI_HOST, &bus_cfg, SPI_DMA_CH_AUTO));
+
+    spi_device_interface_config_t dev_cfg{};
+    dev_cfg.mode = 0;
+    dev_cfg.clock_speed_hz = DOTSTAR_SPI_HZ;
+    dev_cfg.spics_io_num = -1;
+    dev_cfg.queue_size = 1;
+    ESP_ERROR_CHECK(spi_bus_add_device(DOTSTAR_SPI_HOST, &dev_cfg, &spi_));
+
+    // Don't wait here for the LED to power up, the frame is sent by a later
+    // setColor once it is ready.
+    ready_time_ms_ = millis64() + DOTSTAR_POWER_ON_MS;
+    sent_ = false;
   } else {
+    waitForTransaction(portMAX_DELAY);
+    ESP_ERROR_CHECK(spi_bus_remove_device(spi_));
+    ESP_ERROR_CHECK(spi_bus_free(DOTSTAR_SPI_HOST));
+    spi_ = nullptr;
+
+    // Hold the SPI lines low so the LED doesn't get powered through them
+    gpio_config_t gpio_spi_cfg{};
+    gpio_spi_cfg.mode = GPIO_MODE_INPUT;
+    gpio_spi_cfg.pin_bit_mask = ((1ULL << DOTSTAR_DATA) | (1ULL << DOTSTAR_CLK));
+    gpio_spi_cfg.pull_down_en = GPIO_PULLDOWN_ENABLE;
+    ESP_ERROR_CHECK(gpio_config(&gpio_spi_cfg));
+
     ESP_ERROR_CHECK(rtc_gpio_isolate(DOTSTAR_PWR));
   }
 
@@ -59,47 +76,63 @@ void Dotstar::setPower(bool state) {
 }
 
 void Dotstar::setColor(uint8_t color[3]) {
-  bool color_changed = false;
+  memcpy(color_, color, sizeof(color_));
 
   if (!state_) {
-    color_changed = true;
     setPower(true);
-    vTaskDelay(pdMS_TO_TICKS(10)); // TODO: Avoid blocking the main task here
   }
 
-  for (int i = 0; i < 3; i++) {
-    color_changed = color_changed || (color_[i] != color[i]);
-    color_[i] = color[i];
+  if (sent_ && memcmp(sent_color_, color_, sizeof(color_)) == 0) {
+    return;
   }
-
-  if (!color_changed) {
+  if (millis64() < ready_time_ms_) {
     return;
   }
+  send();
+}
 
-  // Start-frame marker
-  for (int i = 0; i < 4; i++)
-    swspi_out(0x00);
+uint64_t Dotstar::nextUpdateMillis() {
+  if (!state_ || (sent_ && memcmp(sent_color_, color_, sizeof(color_)) == 0)) {
+    return UINT64_MAX;
+  }
+  // A frame that was held back by an in-flight transaction is retried on the
+  // next tick.
+  return std::max(ready_time_ms_, millis64() + 1);
+}
 
-  // Pixel start
-  swspi_out(0xFF);
+void Dotstar::send() {
+  waitForTransaction(0);
+  if (in_flight_) {
+    return;
+  }
 
-  for (int i = 2; i >= 0; i--) {
-    swspi_out(color[i]); // R,G,B @Full brightness (no scaling)
+  // Start-frame marker
+  memset(s_frame, 0x00, 4);
+  // Pixel start at full brightness (no scaling), then B,G,R
+  s_frame[4] = 0xFF;
+  for (int i = 0; i < 3; i++) {
+    s_frame[5 + i] = color_[2 - i];
   }
+  // End frame marker
+  s_frame[8] = 0xFF;
+
+  transaction_ = spi_transaction_t{};
+  transaction_.length = DOTSTAR_FRAME_SIZE * 8;
+  transaction_.tx_buffer = s_frame;
+  ESP_ERROR_CHECK(spi_device_queue_trans(spi_, &transaction_, 0));
+  in_flight_ = true;
 
-  // // End frame marker
-  swspi_out(0xFF);
+  memcpy(sent_color_, color_, sizeof(color_));
+  sent_ = true;
 }
 
-void Dotstar::swspi_out(uint8_t n) {
-  for (uint8_t i = 8; i--; n <<= 1) {
-    if (n & 0x80)
-      gpio_set_level(DOTSTAR_DATA, 1);
-    else
-      gpio_set_level(DOTSTAR_DATA, 0);
-    gpio_set_level(DOTSTAR_CLK, 1);
-    gpio_set_level(DOTSTAR_CLK, 0);
+void Dotstar::waitForTransaction(TickType_t ticks) {
+  if (!in_flight_) {
+    return;
+  }
+
+  spi_transaction_t *done;
+  if (spi_device_get_trans_result(spi_, &done, ticks) == ESP_OK) {
+    in_flight_ = false;
   }
-  // TODO: Replace this bit banging with hardware SPI
-  delay_microseconds(1);
 }
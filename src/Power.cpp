@@ -4,6 +4,7 @@
 #include "esp_adc/adc_cali_scheme.h"
 #include "esp_log.h"
 
+#include "events.h"
 #include "helpers.h"
 
 #define UPPER_DIVIDER 442
@@ -18,6 +19,8 @@
 
 const static char *TAG = "PWR";
 
+static void onPwrSenseInterrupt(void *arg) { events_post_from_isr(EVENT_POWER); }
+
 static bool adc_calibration_init(adc_unit_t unit, adc_atten_t atten,
                                  adc_cali_handle_t *out_handle) {
   adc_cali_handle_t handle = NULL;
@@ -88,10 +91,21 @@ void Power::setup() {
   gpio_config_t gpio_cfg{};
   gpio_cfg.mode = GPIO_MODE_INPUT;
   gpio_cfg.pin_bit_mask = (1ULL << PWR_SENSE_GPIO);
+  gpio_cfg.intr_type = GPIO_INTR_ANYEDGE;
   ESP_ERROR_CHECK(gpio_config(&gpio_cfg));
+  // Requires gpio_install_isr_service to have been called
+  ESP_ERROR_CHECK(gpio_isr_handler_add(PWR_SENSE_GPIO, onPwrSenseInterrupt, NULL));
   rtc_gpio_hold_en(PWR_SENSE_GPIO);
 }
 
+uint64_t Power::nextUpdateMillis() {
+  uint64_t next = nextStateReportMillis_;
+  if (pwrSenseLowDeadline_ != 0 && pwrSenseLowDeadline_ < next) {
+    next = pwrSenseLowDeadline_;
+  }
+  return next;
+}
+
 void Power::printState() {
   bool powered = isPowered();
   if (powered == lastReportPoweredState_ && nextStateReportMillis_ > millis64()) {
@@ -135,7 +149,7 @@ bool Power::isPowered() {
   if (gpio_get_level(PWR_SENSE_GPIO) == 0) {
     if (pwrSenseLowDeadline_ == 0) {
       pwrSenseLowDeadline_ = millis64() + PWR_SENSE_LOW_DELAY_MS;
-    } else if (pwrSenseLowDeadline_ < millis64()) {
+    } else if (pwrSenseLowDeadline_ <= millis64()) {
       return false;
     }
   } else {
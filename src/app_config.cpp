@@ -1,150 +1,486 @@
 #include "app_config.h"
 
+#include <algorithm>
+#include <assert.h>
 #include <cstring>
 
 #include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "nvs_flash.h"
 
+#include "events.h"
+#include "helpers.h"
 #include "light.h"
 #include "wifi_credentials.h"
+#include "worker.h"
 
-#define NVS_CONFIG_VERSION 9
+#define NVS_CONFIG_VERSION 10
 #define STORAGE_NAMESPACE "config"
+#define CONFIG_KEY "config"
+
+// Edits are written once there has been no other edit for this long, or this
+// long after the first unwritten edit if they keep coming.
+#define CONFIG_WRITE_DELAY_MS 2000
+#define CONFIG_WRITE_MAX_DELAY_MS 10000
+
+// The record is a header of version (u16), payload length (u16) and CRC-32 of
+// the payload (u32), all little endian. The payload is the SSID, password,
+// active profile, profile count, then each profile's name, action count and
+// encoded actions.
+#define CONFIG_HEADER_SIZE 8
+#define CONFIG_PROFILE_MAX_SIZE                                                                    \
+  (LIGHT_MANAGER_PROFILE_NAME_SIZE + 1 + LIGHT_MANAGER_MAX_ACTIONS * LIGHT_MANAGER_ACTION_SIZE)
+#define CONFIG_RECORD_MAX_SIZE                                                                     \
+  (CONFIG_HEADER_SIZE + APP_CONFIG_WIFI_SSID_SIZE + APP_CONFIG_WIFI_PSWD_SIZE + 2 +                \
+   LIGHT_MANAGER_MAX_PROFILES * CONFIG_PROFILE_MAX_SIZE)
+
+static_assert(LIGHT_MANAGER_MAX_ACTIONS <= UINT8_MAX, "The record counts actions in a byte");
 
 const static char *TAG = "cfg";
 
-static std::vector<LightManager::Action> default_actions = {
-    // Prewake
-    // LightManager::Action{LightManager::HrMin{.hour = 6, .minute = 25},
-    //                      {255, 0, 0}},
-    // Wake
-    LightManager::Action{LightManager::HrMin{.hour = 7, .minute = 00}, LIGHT_COLOR_GREEN},
-    // Wake off
-    LightManager::Action{LightManager::HrMin{.hour = 8, .minute = 00}, LIGHT_COLOR_OFF},
-    // Nap
-    LightManager::Action{LightManager::HrMin{.hour = 13, .minute = 15}, LIGHT_COLOR_RED},
-    // Nap wake
-    LightManager::Action{LightManager::HrMin{.hour = 14, .minute = 45}, LIGHT_COLOR_GREEN},
-    // Nap wake off
-    LightManager::Action{LightManager::HrMin{.hour = 15, .minute = 45}, LIGHT_COLOR_OFF},
-    // Pre-sleep
-    LightManager::Action{LightManager::HrMin{.hour = 18, .minute = 30}, LIGHT_COLOR_WHITE},
-    // Sleep
-    LightManager::Action{LightManager::HrMin{.hour = 19, .minute = 30}, LIGHT_COLOR_RED},
+struct Config {
+  char wifi_ssid[APP_CONFIG_WIFI_SSID_SIZE];
+  char wifi_pswd[APP_CONFIG_WIFI_PSWD_SIZE];
+  uint8_t active_profile;
+  LightManager::Profiles profiles;
 };
 
-bool config_load_internal(nvs_handle_t handle, std::vector<LightManager::Action> &actions,
-                          char wifi_ssid[APP_CONFIG_WIFI_SSID_SIZE],
-                          char wifi_pswd[APP_CONFIG_WIFI_PSWD_SIZE]) {
+static const LightManager::Profiles default_profiles = {
+    LightManager::Profile{
+        "daily",
+        {
+            // Prewake
+            // LightManager::Action{LightManager::HrMin{.hour = 6, .minute = 25},
+            //                      {255, 0, 0}},
+            // Wake
+            LightManager::Action{LightManager::HrMin{.hour = 7, .minute = 00}, LIGHT_COLOR_GREEN},
+            // Wake off
+            LightManager::Action{LightManager::HrMin{.hour = 8, .minute = 00}, LIGHT_COLOR_OFF},
+            // Nap
+            LightManager::Action{LightManager::HrMin{.hour = 13, .minute = 15}, LIGHT_COLOR_RED},
+            // Nap wake
+            LightManager::Action{LightManager::HrMin{.hour = 14, .minute = 45}, LIGHT_COLOR_GREEN},
+            // Nap wake off
+            LightManager::Action{LightManager::HrMin{.hour = 15, .minute = 45}, LIGHT_COLOR_OFF},
+            // Pre-sleep
+            LightManager::Action{LightManager::HrMin{.hour = 18, .minute = 30}, LIGHT_COLOR_WHITE},
+            // Sleep
+            LightManager::Action{LightManager::HrMin{.hour = 19, .minute = 30}, LIGHT_COLOR_RED},
+        }},
+    // Same as daily but sleeping in an hour on weekends
+    LightManager::Profile{
+        "weekend",
+        {
+            // Wake
+            LightManager::Action{LightManager::HrMin{.hour = 7, .minute = 00}, LIGHT_COLOR_GREEN,
+                                 LightManager::WEEKDAYS},
+            // Wake off
+            LightManager::Action{LightManager::HrMin{.hour = 8, .minute = 00}, LIGHT_COLOR_OFF,
+                                 LightManager::WEEKDAYS},
+            // Nap
+            LightManager::Action{LightManager::HrMin{.hour = 13, .minute = 15}, LIGHT_COLOR_RED},
+            // Nap wake
+            LightManager::Action{LightManager::HrMin{.hour = 14, .minute = 45}, LIGHT_COLOR_GREEN},
+            // Nap wake off
+            LightManager::Action{LightManager::HrMin{.hour = 15, .minute = 45}, LIGHT_COLOR_OFF},
+            // Pre-sleep
+            LightManager::Action{LightManager::HrMin{.hour = 18, .minute = 30}, LIGHT_COLOR_WHITE},
+            // Sleep
+            LightManager::Action{LightManager::HrMin{.hour = 19, .minute = 30}, LIGHT_COLOR_RED},
+            // Weekend wake
+            LightManager::Action{LightManager::HrMin{.hour = 8, .minute = 00}, LIGHT_COLOR_GREEN,
+                                 LightManager::WEEKEND},
+            // Weekend wake off
+            LightManager::Action{LightManager::HrMin{.hour = 9, .minute = 00}, LIGHT_COLOR_OFF,
+                                 LightManager::WEEKEND},
+        }},
+};
+
+// The config as last loaded or edited. Setters may run on other tasks so it
+// is only touched under s_config_lock.
+static Config s_config;
+static bool s_dirty;
+static uint64_t s_first_edit_ms;
+static uint64_t s_flush_ms;
+// Set while a flush is queued on the worker
+static bool s_flush_queued;
+static portMUX_TYPE s_config_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Identifies the stored record so unchanged config isn't rewritten
+static uint32_t s_stored_crc;
+static size_t s_stored_size;
+
+// Flushes run on the worker, or on the main task before sleeping, so the
+// record buffer and stats are only touched under s_flush_mutex after loading.
+// Created by config_init rather than config_load because a resume from a deep
+// sleep snapshot flushes before sleeping again without ever loading the
+// config.
+static StaticSemaphore_t s_flush_mutex_buf;
+static SemaphoreHandle_t s_flush_mutex;
+static uint8_t s_record[CONFIG_RECORD_MAX_SIZE];
+static config_stats_t s_stats;
+
+static uint8_t *put_u16(uint8_t *out, uint16_t value) {
+  *out++ = value & 0xff;
+  *out++ = value >> 8;
+  return out;
+}
+
+static uint16_t get_u16(const uint8_t *in) { return in[0] | (in[1] << 8); }
+
+static uint32_t get_u32(const uint8_t *in) { return get_u16(in) | ((uint32_t)get_u16(in + 2) << 16); }
 
-  uint16_t version = 0;
-  esp_err_t err = nvs_get_u16(handle, "version", &version);
-  if (err == ESP_ERR_NVS_NOT_FOUND) {
-    ESP_LOGI(TAG, "No config stored");
+static size_t encode_record(const Config &config, uint8_t *buf) {
+  uint8_t *out = buf + CONFIG_HEADER_SIZE;
+  std::memcpy(out, config.wifi_ssid, APP_CONFIG_WIFI_SSID_SIZE);
+  out += APP_CONFIG_WIFI_SSID_SIZE;
+  std::memcpy(out, config.wifi_pswd, APP_CONFIG_WIFI_PSWD_SIZE);
+  out += APP_CONFIG_WIFI_PSWD_SIZE;
+  *out++ = config.active_profile;
+  *out++ = config.profiles.size();
+  for (const LightManager::Profile &profile : config.profiles) {
+    std::memcpy(out, profile.name, LIGHT_MANAGER_PROFILE_NAME_SIZE);
+    out += LIGHT_MANAGER_PROFILE_NAME_SIZE;
+    *out++ = profile.actions.size();
+    out += LightManager::encode(profile.actions, out);
+  }
+
+  uint16_t length = out - buf - CONFIG_HEADER_SIZE;
+  uint32_t crc = esp_rom_crc32_le(0, buf + CONFIG_HEADER_SIZE, length);
+  out = put_u16(buf, NVS_CONFIG_VERSION);
+  out = put_u16(out, length);
+  out = put_u16(out, crc & 0xffff);
+  put_u16(out, crc >> 16);
+
+  return CONFIG_HEADER_SIZE + length;
+}
+
+// Returns false if the record is truncated, corrupt or from another version
+static bool decode_record(const uint8_t *buf, size_t size, Config &config) {
+  if (size < CONFIG_HEADER_SIZE || get_u16(buf) != NVS_CONFIG_VERSION) {
     return false;
   }
-  ESP_ERROR_CHECK(err);
-  if (version != NVS_CONFIG_VERSION) {
-    ESP_LOGI(TAG, "Stored config is v%d, want %d", version, NVS_CONFIG_VERSION);
+  uint16_t length = get_u16(buf + 2);
+  if (size != (size_t)CONFIG_HEADER_SIZE + length ||
+      get_u32(buf + 4) != esp_rom_crc32_le(0, buf + CONFIG_HEADER_SIZE, length)) {
+    ESP_LOGE(TAG, "Stored config is corrupt");
     return false;
   }
 
-  size_t length = APP_CONFIG_WIFI_SSID_SIZE;
-  ESP_ERROR_CHECK(nvs_get_blob(handle, "ssid", wifi_ssid, &length));
-  if (length == 0) {
-    ESP_LOGI(TAG, "No SSID stored");
+  const uint8_t *in = buf + CONFIG_HEADER_SIZE;
+  const uint8_t *end = in + length;
+  if (end - in < APP_CONFIG_WIFI_SSID_SIZE + APP_CONFIG_WIFI_PSWD_SIZE + 2) {
+    return false;
+  }
+  std::memcpy(config.wifi_ssid, in, APP_CONFIG_WIFI_SSID_SIZE);
+  in += APP_CONFIG_WIFI_SSID_SIZE;
+  std::memcpy(config.wifi_pswd, in, APP_CONFIG_WIFI_PSWD_SIZE);
+  in += APP_CONFIG_WIFI_PSWD_SIZE;
+  config.active_profile = *in++;
+  if (!config.profiles.resize(*in++)) {
     return false;
   }
 
+  for (LightManager::Profile &profile : config.profiles) {
+    if (end - in < LIGHT_MANAGER_PROFILE_NAME_SIZE + 1) {
+      return false;
+    }
+    std::memcpy(profile.name, in, LIGHT_MANAGER_PROFILE_NAME_SIZE);
+    profile.name[LIGHT_MANAGER_PROFILE_NAME_SIZE - 1] = 0;
+    in += LIGHT_MANAGER_PROFILE_NAME_SIZE;
+    size_t actions_size = *in++ * LIGHT_MANAGER_ACTION_SIZE;
+    if ((size_t)(end - in) < actions_size ||
+        !LightManager::decode(in, actions_size, profile.actions)) {
+      return false;
+    }
+    in += actions_size;
+  }
+
+  return in == end && !config.profiles.empty() &&
+         config.active_profile < config.profiles.size();
+}
+
+// v9 had each setting under its own key and a single schedule in "actions",
+// each Action struct stored as is: the time, two bytes of padding and three
+// color pointers. The pointers only ever pointed at the default colors, so it
+// becomes the first default profile with the stored times and each color
+// taken from the matching default action.
+#define V9_ACTION_SIZE 16
+
+static bool migrate_v9(nvs_handle_t handle, Config &config) {
+  size_t length = APP_CONFIG_WIFI_SSID_SIZE;
+  if (nvs_get_blob(handle, "ssid", config.wifi_ssid, &length) != ESP_OK) {
+    return false;
+  }
   length = APP_CONFIG_WIFI_PSWD_SIZE;
-  ESP_ERROR_CHECK(nvs_get_blob(handle, "pswd", wifi_pswd, &length));
-  if (length == 0) {
-    ESP_LOGI(TAG, "No password stored");
+  if (nvs_get_blob(handle, "pswd", config.wifi_pswd, &length) != ESP_OK) {
     return false;
   }
 
-  // Read the size of memory space required for blob
-  size_t actions_size = 0; // value will default to 0, if not set yet in NVS
-  ESP_ERROR_CHECK(nvs_get_blob(handle, "actions", NULL, &actions_size));
-
-  if (actions_size == 0) {
-    ESP_LOGI(TAG, "No actions stored");
+  config.active_profile = 0;
+  config.profiles = default_profiles;
+  LightManager::Actions &actions = config.profiles[0].actions;
+  length = sizeof(s_record);
+  if (nvs_get_blob(handle, "actions", s_record, &length) != ESP_OK ||
+      length % V9_ACTION_SIZE != 0 || !actions.resize(length / V9_ACTION_SIZE)) {
     return false;
   }
 
-  LightManager::Action *action_arr = (LightManager::Action *)malloc(actions_size);
-  nvs_get_blob(handle, "actions", action_arr, &actions_size);
+  const LightManager::Actions &defaults = default_profiles[0].actions;
+  for (size_t i = 0; i < actions.size(); i++) {
+    const uint8_t *in = s_record + i * V9_ACTION_SIZE;
+    actions[i].time = LightManager::HrMin{in[0], in[1]};
+    actions[i].color = i < defaults.size() ? defaults[i].color : LIGHT_COLOR_OFF;
+    actions[i].days = LightManager::EVERY_DAY;
+  }
+  return true;
+}
 
-  actions.assign(action_arr, action_arr + actions_size / sizeof(LightManager::Action));
+// Reads config stored by an older version. The result is written back as the
+// current record, so each entry only ever runs once per device. Later record
+// versions are migrated the same way, from the record still in s_record.
+static const struct {
+  uint16_t version;
+  bool (*migrate)(nvs_handle_t handle, Config &config);
+} s_migrations[] = {
+    {9, migrate_v9},
+};
 
-  return true;
+static void erase_legacy_keys(nvs_handle_t handle) {
+  const char *keys[] = {"version", "ssid", "pswd", "actions"};
+  for (const char *key : keys) {
+    nvs_erase_key(handle, key);
+  }
 }
 
-void config_set_ssid_internal(nvs_handle_t handle,
-                              const char wifi_ssid[APP_CONFIG_WIFI_SSID_SIZE]) {
-  ESP_ERROR_CHECK(nvs_set_blob(handle, "ssid", wifi_ssid, APP_CONFIG_WIFI_SSID_SIZE));
+static bool migrate(nvs_handle_t handle, uint16_t version, Config &config) {
+  for (const auto &migration : s_migrations) {
+    if (migration.version == version) {
+      ESP_LOGI(TAG, "Migrating config from v%d", version);
+      return migration.migrate(handle, config) && !config.profiles.empty() &&
+             config.active_profile < config.profiles.size();
+    }
+  }
+  ESP_LOGI(TAG, "No migration from config v%d", version);
+  return false;
 }
 
-void config_set_pswd_internal(nvs_handle_t handle,
-                              const char wifi_pswd[APP_CONFIG_WIFI_PSWD_SIZE]) {
-  ESP_ERROR_CHECK(nvs_set_blob(handle, "pswd", wifi_pswd, APP_CONFIG_WIFI_PSWD_SIZE));
+// Writes the record if it differs from what is stored, setting `wrote`. Until
+// the caller commits, what's stored is only known if this fails.
+static esp_err_t write_record(nvs_handle_t handle, const Config &config, bool *wrote) {
+  *wrote = false;
+  size_t size = encode_record(config, s_record);
+  uint32_t crc = get_u32(s_record + 4);
+  if (size == s_stored_size && crc == s_stored_crc) {
+    return ESP_OK;
+  }
+
+  esp_err_t err = nvs_set_blob(handle, CONFIG_KEY, s_record, size);
+  if (err != ESP_OK) {
+    return err;
+  }
+  s_stored_size = size;
+  s_stored_crc = crc;
+  s_stats.writes++;
+  s_stats.bytes += size;
+  *wrote = true;
+  return ESP_OK;
 }
 
-void config_set_actions_internal(nvs_handle_t handle, std::vector<LightManager::Action> &actions) {
-  ESP_ERROR_CHECK(
-      nvs_set_blob(handle, "actions", &actions[0], sizeof(LightManager::Action) * actions.size()));
+// Keeps the config staged after a failed write or commit so a later flush
+// tries again. What's stored is unknown by then, so that write isn't skipped
+// as unchanged. Edits made since the config was copied out are already staged
+// and stay due as they were. Must be called with s_config_lock held.
+static void retry_later() {
+  s_stored_size = 0;
+  s_stored_crc = 0;
+  if (!s_dirty) {
+    s_dirty = true;
+    s_first_edit_ms = millis64();
+    s_flush_ms = s_first_edit_ms + CONFIG_WRITE_MAX_DELAY_MS;
+  }
 }
 
-void config_load(std::vector<LightManager::Action> &actions,
+void config_init() { s_flush_mutex = xSemaphoreCreateMutexStatic(&s_flush_mutex_buf); }
+
+void config_load(LightManager::Profiles &profiles, uint8_t *active_profile,
                  char wifi_ssid[APP_CONFIG_WIFI_SSID_SIZE],
                  char wifi_pswd[APP_CONFIG_WIFI_PSWD_SIZE]) {
   nvs_handle_t handle;
-
-  // Open
   ESP_ERROR_CHECK(nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle));
 
-  bool success = config_load_internal(handle, actions, wifi_ssid, wifi_pswd);
-  if (success) {
-    return;
-  }
-
-  // Load defaults
-  // TODO: Should we erase first?
-  ESP_LOGI(TAG, "Using config defaults");
-  config_set_ssid_internal(handle, default_wifi_ssid);
-  config_set_pswd_internal(handle, default_wifi_pswd);
-  config_set_actions_internal(handle, default_actions);
+  // Nothing else touches the config until it's loaded
+  size_t size = sizeof(s_record);
+  esp_err_t err = nvs_get_blob(handle, CONFIG_KEY, s_record, &size);
+  if (err == ESP_OK && decode_record(s_record, size, s_config)) {
+    s_stored_size = size;
+    s_stored_crc = get_u32(s_record + 4);
+  } else {
+    uint16_t version = 0;
+    if (err == ESP_OK && size >= CONFIG_HEADER_SIZE) {
+      version = get_u16(s_record);
+    } else {
+      nvs_get_u16(handle, "version", &version);
+    }
+    if (version != NVS_CONFIG_VERSION) {
+      ESP_LOGI(TAG, "Stored config is v%d, want %d", version, NVS_CONFIG_VERSION);
+    }
 
-  ESP_ERROR_CHECK(nvs_set_u16(handle, "version", NVS_CONFIG_VERSION));
+    if (version == NVS_CONFIG_VERSION || !migrate(handle, version, s_config)) {
+      ESP_LOGI(TAG, "Using config defaults");
+      std::memcpy(s_config.wifi_ssid, default_wifi_ssid, sizeof(default_wifi_ssid));
+      std::memcpy(s_config.wifi_pswd, default_wifi_pswd, sizeof(default_wifi_pswd));
+      s_config.active_profile = 0;
+      s_config.profiles = default_profiles;
+    }
 
-  ESP_ERROR_CHECK(nvs_commit(handle));
+    // The config loaded or migrated is used either way, and the next flush
+    // tries the write again
+    bool wrote;
+    err = write_record(handle, s_config, &wrote);
+    if (err == ESP_OK) {
+      erase_legacy_keys(handle);
+      err = nvs_commit(handle);
+    }
+    if (err == ESP_OK) {
+      s_stats.commits++;
+    } else {
+      ESP_LOGE(TAG, "Unable to save config, retrying later: %s", esp_err_to_name(err));
+      portENTER_CRITICAL(&s_config_lock);
+      retry_later();
+      portEXIT_CRITICAL(&s_config_lock);
+    }
+  }
   nvs_close(handle);
 
-  std::memcpy(wifi_ssid, default_wifi_ssid, sizeof(default_wifi_ssid));
-  std::memcpy(wifi_pswd, default_wifi_pswd, sizeof(default_wifi_pswd));
-  actions = default_actions;
+  std::memcpy(wifi_ssid, s_config.wifi_ssid, APP_CONFIG_WIFI_SSID_SIZE);
+  std::memcpy(wifi_pswd, s_config.wifi_pswd, APP_CONFIG_WIFI_PSWD_SIZE);
+  profiles = s_config.profiles;
+  *active_profile = s_config.active_profile;
+}
+
+// Must be called with s_config_lock held
+static void mark_dirty() {
+  uint64_t now = millis64();
+  if (!s_dirty) {
+    s_first_edit_ms = now;
+  }
+  s_dirty = true;
+  s_flush_ms = std::min(now + CONFIG_WRITE_DELAY_MS, s_first_edit_ms + CONFIG_WRITE_MAX_DELAY_MS);
 }
 
 void config_set_ssid(const char wifi_ssid[APP_CONFIG_WIFI_SSID_SIZE]) {
-  nvs_handle_t handle;
-  ESP_ERROR_CHECK(nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle));
-  config_set_ssid_internal(handle, wifi_ssid);
-  ESP_ERROR_CHECK(nvs_commit(handle));
-  nvs_close(handle);
+  portENTER_CRITICAL(&s_config_lock);
+  std::memcpy(s_config.wifi_ssid, wifi_ssid, APP_CONFIG_WIFI_SSID_SIZE);
+  mark_dirty();
+  portEXIT_CRITICAL(&s_config_lock);
+  events_post(EVENT_CONFIG);
 }
 
 void config_set_pswd(const char wifi_pswd[APP_CONFIG_WIFI_PSWD_SIZE]) {
-  nvs_handle_t handle;
-  ESP_ERROR_CHECK(nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle));
-  config_set_pswd_internal(handle, wifi_pswd);
-  ESP_ERROR_CHECK(nvs_commit(handle));
-  nvs_close(handle);
+  portENTER_CRITICAL(&s_config_lock);
+  std::memcpy(s_config.wifi_pswd, wifi_pswd, APP_CONFIG_WIFI_PSWD_SIZE);
+  mark_dirty();
+  portEXIT_CRITICAL(&s_config_lock);
+  events_post(EVENT_CONFIG);
+}
+
+void config_set_profile(uint8_t idx, const LightManager::Profile &profile) {
+  assert(idx < s_config.profiles.size());
+  portENTER_CRITICAL(&s_config_lock);
+  s_config.profiles[idx] = profile;
+  mark_dirty();
+  portEXIT_CRITICAL(&s_config_lock);
+  events_post(EVENT_CONFIG);
+}
+
+void config_set_active_profile(uint8_t idx) {
+  portENTER_CRITICAL(&s_config_lock);
+  s_config.active_profile = idx;
+  mark_dirty();
+  portEXIT_CRITICAL(&s_config_lock);
+  events_post(EVENT_CONFIG);
+}
+
+uint64_t config_next_flush_millis() {
+  portENTER_CRITICAL(&s_config_lock);
+  uint64_t flush_ms = s_dirty && !s_flush_queued ? s_flush_ms : UINT64_MAX;
+  portEXIT_CRITICAL(&s_config_lock);
+  return flush_ms;
+}
+
+static void config_flush_job(void *arg) {
+  config_flush();
+
+  portENTER_CRITICAL(&s_config_lock);
+  s_flush_queued = false;
+  portEXIT_CRITICAL(&s_config_lock);
+  // Edits made during the flush are due again
+  events_post(EVENT_CONFIG);
 }
 
-void config_set_actions(std::vector<LightManager::Action> &actions) {
+void config_poll() {
+  if (config_next_flush_millis() > millis64()) {
+    return;
+  }
+
+  portENTER_CRITICAL(&s_config_lock);
+  s_flush_queued = true;
+  portEXIT_CRITICAL(&s_config_lock);
+  if (!worker_submit(&config_flush_job, NULL)) {
+    config_flush_job(NULL);
+  }
+}
+
+void config_flush() {
+  // Copy the config out so the lock isn't held while writing to flash
+  static Config config;
+
+  xSemaphoreTake(s_flush_mutex, portMAX_DELAY);
+  portENTER_CRITICAL(&s_config_lock);
+  bool dirty = s_dirty;
+  s_dirty = false;
+  if (dirty) {
+    config = s_config;
+  }
+  portEXIT_CRITICAL(&s_config_lock);
+
+  if (!dirty) {
+    xSemaphoreGive(s_flush_mutex);
+    return;
+  }
+
+  int64_t start = esp_timer_get_time();
+  bool changed = false;
   nvs_handle_t handle;
-  ESP_ERROR_CHECK(nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle));
-  config_set_actions_internal(handle, actions);
-  ESP_ERROR_CHECK(nvs_commit(handle));
-  nvs_close(handle);
+  esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle);
+  if (err == ESP_OK) {
+    err = write_record(handle, config, &changed);
+    if (err == ESP_OK && changed) {
+      err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+  }
+
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Unable to save config, retrying later: %s", esp_err_to_name(err));
+    portENTER_CRITICAL(&s_config_lock);
+    retry_later();
+    portEXIT_CRITICAL(&s_config_lock);
+    xSemaphoreGive(s_flush_mutex);
+    return;
+  }
+  if (changed) {
+    s_stats.commits++;
+  }
+
+  ESP_LOGI(TAG, "Flushed in %lldus, %s; totals: %lu writes, %lu bytes, %lu commits",
+           esp_timer_get_time() - start, changed ? "committed" : "unchanged", s_stats.writes,
+           s_stats.bytes, s_stats.commits);
+  xSemaphoreGive(s_flush_mutex);
 }
+
+config_stats_t config_get_stats() { return s_stats; }
@@ -1,9 +1,15 @@
-#include <vector>
+#include <algorithm>
 
 #include "bt.h"
 #include "console/console.h"
+#include "esp_bt.h"
 #include "esp_log.h"
 #include "esp_nimble_hci.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "helpers.h"
 #include "host/ble_hs.h"
 #include "host/ble_uuid.h"
 #include "host/util/util.h"
@@ -17,6 +23,37 @@ struct ble_hs_cfg;
 struct ble_gatt_register_ctxt;
 
 #define GATT_SVR_SVC_ALERT_UUID 0x1811
+// How long stopping waits for connections to close before cutting them off
+#define BT_STOP_TIMEOUT_MS 200
+
+// Advertising starts fast so a phone nearby finds the device straight away,
+// then settles to a slow interval until something connects
+#define BT_ADV_FAST_INTERVAL_MS 30
+#define BT_ADV_FAST_DURATION_MS (30 * 1000)
+#define BT_ADV_SLOW_INTERVAL_MS 1000
+
+// Connections start with short intervals for discovery and configuration.
+// Once there's been no GATT access for BT_CONN_IDLE_MS the central is asked
+// for long ones, and the next access asks for short ones again.
+#define BT_CONN_IDLE_MS (5 * 1000)
+#define BT_CONN_FAST_MIN_MS 15
+#define BT_CONN_FAST_MAX_MS 30
+#define BT_CONN_IDLE_MIN_MS 400
+#define BT_CONN_IDLE_MAX_MS 500
+// Connection events the peripheral may skip when it has nothing to send
+#define BT_CONN_IDLE_LATENCY 4
+#define BT_CONN_SUPERVISION_TIMEOUT_MS 6000
+
+// Rough ESP32 figures for the average current logged whenever the radio's
+// schedule changes: the draw while the radio is up for an event, and how long
+// it's up for each advertising event (all three channels) and each empty
+// connection event, wake up included.
+#define BT_RADIO_UA 100000
+#define BT_ADV_EVENT_US 2500
+#define BT_CONN_EVENT_US 1500
+// Between events the radio modem sleeps and the CPU idles at the XTAL
+// frequency
+#define BT_IDLE_UA 15000
 
 // BLE_UUID128_INIT isn't c++11 compatible
 #define BT_UUID128_INIT(uuid128...)                                                                \
@@ -27,29 +64,123 @@ static const ble_uuid128_t gatt_svr_svc_uuid = BT_UUID128_INIT(
     0x2d, 0x71, 0xa2, 0x59, 0xb4, 0x58, 0xc8, 0x12, 0x99, 0x99, 0x43, 0x95, 0x12, 0x2f, 0x46, 0x59);
 
 /* 5c3a659e-897e-45e1-b016-007107c96d00 */
-static ble_uuid128_t gatt_svr_chr_base = BT_UUID128_INIT(
+static constexpr ble_uuid128_t gatt_svr_chr_base = BT_UUID128_INIT(
     0x00, 0x6d, 0xc9, 0x07, 0x71, 0x00, 0x16, 0xb0, 0xe1, 0x45, 0x7e, 0x89, 0x9e, 0x65, 0x3a, 0x5c);
 
 /* 5c3a659e-897e-45e1-b016-007107c86d00 */
-static ble_uuid128_t gatt_svr_desc_base = BT_UUID128_INIT(
+static constexpr ble_uuid128_t gatt_svr_desc_base = BT_UUID128_INIT(
     0x00, 0x6d, 0xc8, 0x07, 0x71, 0x00, 0x16, 0xb0, 0xe1, 0x45, 0x7e, 0x89, 0x9e, 0x65, 0x3a, 0x5c);
 
-struct bt_chr_entry {
-  const ble_uuid128_t chr_uuid;
-  const ble_uuid128_t desc_uuid;
-  const bt_chr chr;
-  ble_gatt_dsc_def dscs[2];
-};
-
 static const char *tag = "BLE";
 static int bt_gap_event(struct ble_gap_event *event, void *arg);
+static int gatt_svr_chr_access(uint16_t conn_handle, uint16_t attr_handle,
+                               struct ble_gatt_access_ctxt *ctxt, void *arg);
+static int gatt_svr_desc_access(uint16_t conn_handle, uint16_t attr_handle,
+                                struct ble_gatt_access_ctxt *ctxt, void *arg);
 static uint8_t s_own_addr_type;
 static bool s_is_enabled;
-static std::vector<bt_chr_entry> s_chr_entries;
-static ble_gatt_svc_def s_gatt_svr_svcs[2]{
-    {.type = BLE_GATT_SVC_TYPE_PRIMARY, .uuid = &gatt_svr_svc_uuid.u}, {0} // No more services
+static bool s_host_initialized;
+// When bt_start was called, until the advertisement it leads to has started
+static int64_t s_start_us = -1;
+static uint16_t s_conn_handles[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+static size_t s_conn_count;
+// Last GATT access by a client, and whether the idle parameters were asked
+// for since
+static uint64_t s_last_access_ms;
+static bool s_conn_idle;
+
+static const ble_gap_upd_params s_conn_fast_params = {
+    .itvl_min = BLE_GAP_CONN_ITVL_MS(BT_CONN_FAST_MIN_MS),
+    .itvl_max = BLE_GAP_CONN_ITVL_MS(BT_CONN_FAST_MAX_MS),
+    .latency = 0,
+    .supervision_timeout = BLE_GAP_SUPERVISION_TIMEOUT_MS(BT_CONN_SUPERVISION_TIMEOUT_MS),
+};
+static const ble_gap_upd_params s_conn_idle_params = {
+    .itvl_min = BLE_GAP_CONN_ITVL_MS(BT_CONN_IDLE_MIN_MS),
+    .itvl_max = BLE_GAP_CONN_ITVL_MS(BT_CONN_IDLE_MAX_MS),
+    .latency = BT_CONN_IDLE_LATENCY,
+    .supervision_timeout = BLE_GAP_SUPERVISION_TIMEOUT_MS(BT_CONN_SUPERVISION_TIMEOUT_MS),
+};
+
+static bt_chr s_chrs[BT_MAX_CHRS];
+static size_t s_chr_count;
+static uint16_t s_val_handles[BT_MAX_CHRS];
+// Subscriptions to each characteristic, across connections
+static uint8_t s_subscribers[BT_MAX_CHRS];
+// Bitmask of characteristics to notify on the next bt_poll
+static uint32_t s_notify_pending;
+static uint64_t s_last_notify_ms;
+
+static_assert(BT_MAX_CHRS <= 32, "s_notify_pending has a bit per characteristic");
+static_assert(BT_ERR_INVALID_LENGTH == BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN,
+              "BT_ERR_INVALID_LENGTH should match NimBLE");
+
+// Characteristic i, and the descriptor naming it, take the base UUIDs with
+// the first byte set to i
+struct bt_uuids {
+  ble_uuid128_t chr[BT_MAX_CHRS];
+  ble_uuid128_t desc[BT_MAX_CHRS];
+};
+
+static constexpr bt_uuids bt_make_uuids() {
+  bt_uuids uuids{};
+  for (size_t i = 0; i < BT_MAX_CHRS; i++) {
+    uuids.chr[i] = gatt_svr_chr_base;
+    uuids.chr[i].value[0] = i;
+    uuids.desc[i] = gatt_svr_desc_base;
+    uuids.desc[i].value[0] = i;
+  }
+  return uuids;
+}
+
+static constexpr bt_uuids s_uuids = bt_make_uuids();
+
+// NimBLE takes the definitions through non-const pointers, so the tables
+// can't be constexpr themselves, but they're constant initialized from these
+// and never built at runtime. Registering only fills in the flags and where
+// the table ends.
+struct bt_dsc_table {
+  ble_gatt_dsc_def dscs[BT_MAX_CHRS][2];
+};
+
+static constexpr bt_dsc_table bt_make_dscs() {
+  bt_dsc_table table{};
+  for (size_t i = 0; i < BT_MAX_CHRS; i++) {
+    table.dscs[i][0].uuid = &s_uuids.desc[i].u;
+    table.dscs[i][0].att_flags = BLE_ATT_F_READ;
+    table.dscs[i][0].access_cb = gatt_svr_desc_access;
+    table.dscs[i][0].arg = &s_chrs[i];
+  }
+  return table;
+}
+
+static bt_dsc_table s_dscs = bt_make_dscs();
+
+// One spare entry for the terminator after the last registration
+struct bt_chr_table {
+  ble_gatt_chr_def chrs[BT_MAX_CHRS + 1];
+};
+
+static constexpr bt_chr_table bt_make_chrs() {
+  bt_chr_table table{};
+  for (size_t i = 0; i < BT_MAX_CHRS; i++) {
+    table.chrs[i].uuid = &s_uuids.chr[i].u;
+    table.chrs[i].access_cb = gatt_svr_chr_access;
+    table.chrs[i].arg = &s_chrs[i];
+    table.chrs[i].descriptors = s_dscs.dscs[i];
+    table.chrs[i].val_handle = &s_val_handles[i];
+  }
+  return table;
+}
+
+static bt_chr_table s_gatt_svr_chrs = bt_make_chrs();
+
+static const ble_gatt_svc_def s_gatt_svr_svcs[2]{
+    {.type = BLE_GATT_SVC_TYPE_PRIMARY,
+     .uuid = &gatt_svr_svc_uuid.u,
+     .characteristics = s_gatt_svr_chrs.chrs},
+    {0} // No more services
 };
-static std::vector<ble_gatt_chr_def> s_gatt_svr_chrs;
 
 extern "C" void ble_store_config_init(void);
 
@@ -73,7 +204,7 @@ static int gatt_svr_chr_write(struct os_mbuf *om, uint16_t min_len, uint16_t max
 
 static int gatt_svr_desc_access(uint16_t conn_handle, uint16_t attr_handle,
                                 struct ble_gatt_access_ctxt *ctxt, void *arg) {
-  const char *name = s_chr_entries.at((size_t)arg).chr.name;
+  const char *name = ((const bt_chr *)arg)->name;
 
   assert(ctxt->op == BLE_GATT_ACCESS_OP_READ_DSC);
   int rc = os_mbuf_append(ctxt->om, name, strlen(name));
@@ -83,7 +214,16 @@ static int gatt_svr_desc_access(uint16_t conn_handle, uint16_t attr_handle,
 static int gatt_svr_chr_access(uint16_t conn_handle, uint16_t attr_handle,
                                struct ble_gatt_access_ctxt *ctxt, void *arg) {
   int rc;
-  const bt_chr *chr = &s_chr_entries.at((size_t)arg).chr;
+  const bt_chr *chr = (const bt_chr *)arg;
+
+  // Notifications read the value locally, without a connection
+  if (conn_handle != BLE_HS_CONN_HANDLE_NONE) {
+    s_last_access_ms = millis64();
+    if (s_conn_idle) {
+      s_conn_idle = false;
+      ble_gap_update_params(conn_handle, &s_conn_fast_params);
+    }
+  }
 
   switch (ctxt->op) {
   case BLE_GATT_ACCESS_OP_READ_CHR:
@@ -144,12 +284,30 @@ void gatt_svr_register_cb(struct ble_gatt_register_ctxt *ctxt, void *arg) {
   }
 }
 
+// Average current for a radio event of `event_us` every `interval_us`
+static float bt_estimate_ma(uint32_t event_us, uint32_t interval_us) {
+  return (BT_IDLE_UA + (float)(BT_RADIO_UA - BT_IDLE_UA) * event_us / interval_us) / 1000;
+}
+
+static void bt_log_conn(uint16_t conn_handle) {
+  struct ble_gap_conn_desc desc;
+  if (ble_gap_conn_find(conn_handle, &desc) != 0) {
+    return;
+  }
+  // Intervals are in units of 1.25ms, and latency lets idle events be skipped
+  uint32_t interval_us = desc.conn_itvl * 1250 * (desc.conn_latency + 1);
+  ESP_LOGI(tag, "Connected, interval %dms latency %d, ~%.1fmA", desc.conn_itvl * 5 / 4,
+           desc.conn_latency, bt_estimate_ma(BT_CONN_EVENT_US, interval_us));
+}
+
 /**
  * Enables advertising with the following parameters:
  *     o General discoverable mode.
  *     o Undirected connectable mode.
+ *     o A short interval for BT_ADV_FAST_DURATION_MS if `fast`, otherwise a
+ *       long one until stopped.
  */
-static void bt_advertise(void) {
+static void bt_advertise(bool fast) {
   struct ble_gap_adv_params adv_params;
   struct ble_hs_adv_fields fields;
   const char *name;
@@ -202,11 +360,22 @@ static void bt_advertise(void) {
   memset(&adv_params, 0, sizeof adv_params);
   adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
   adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
-  rc = ble_gap_adv_start(s_own_addr_type, NULL, BLE_HS_FOREVER, &adv_params, bt_gap_event, NULL);
+  uint32_t interval_ms = fast ? BT_ADV_FAST_INTERVAL_MS : BT_ADV_SLOW_INTERVAL_MS;
+  adv_params.itvl_min = adv_params.itvl_max = BLE_GAP_ADV_ITVL_MS(interval_ms);
+  rc = ble_gap_adv_start(s_own_addr_type, NULL, fast ? BT_ADV_FAST_DURATION_MS : BLE_HS_FOREVER,
+                         &adv_params, bt_gap_event, NULL);
   if (rc != 0) {
     MODLOG_DFLT(ERROR, "error enabling advertisement; rc=%d\n", rc);
     return;
   }
+  ESP_LOGI(tag, "Advertising every %lums, ~%.1fmA", interval_ms,
+           bt_estimate_ma(BT_ADV_EVENT_US, interval_ms * 1000));
+
+  if (s_start_us >= 0) {
+    ESP_LOGI(tag, "Advertising %lldms after starting",
+             (esp_timer_get_time() - s_start_us) / 1000);
+    s_start_us = -1;
+  }
 }
 
 /**
@@ -236,21 +405,41 @@ static int bt_gap_event(struct ble_gap_event *event, void *arg) {
     if (event->connect.status == 0) {
       rc = ble_gap_conn_find(event->connect.conn_handle, &desc);
       assert(rc == 0);
+      if (s_conn_count < CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
+        s_conn_handles[s_conn_count++] = event->connect.conn_handle;
+      }
+      s_last_access_ms = millis64();
+      s_conn_idle = false;
+      bt_log_conn(event->connect.conn_handle);
+      // Ask for the preferred MTU up front so larger values, like the
+      // schedule, go in one round trip rather than as long reads and writes
+      rc = ble_gattc_exchange_mtu(event->connect.conn_handle, NULL, NULL);
+      if (rc != 0) {
+        MODLOG_DFLT(ERROR, "error exchanging mtu; rc=%d\n", rc);
+      }
     }
     MODLOG_DFLT(INFO, "\n");
 
-    if (event->connect.status != 0) {
+    if (event->connect.status != 0 && s_is_enabled) {
       /* Connection failed; resume advertising. */
-      bt_advertise();
+      bt_advertise(true);
     }
     return 0;
 
   case BLE_GAP_EVENT_DISCONNECT:
     MODLOG_DFLT(INFO, "disconnect; reason=%d ", event->disconnect.reason);
     MODLOG_DFLT(INFO, "\n");
+    for (size_t i = 0; i < s_conn_count; i++) {
+      if (s_conn_handles[i] == event->disconnect.conn.conn_handle) {
+        s_conn_handles[i] = s_conn_handles[--s_conn_count];
+        break;
+      }
+    }
 
-    /* Connection terminated; resume advertising. */
-    bt_advertise();
+    /* Connection terminated; resume advertising unless stopping. */
+    if (s_is_enabled) {
+      bt_advertise(true);
+    }
     return 0;
 
   case BLE_GAP_EVENT_CONN_UPDATE:
@@ -259,11 +448,15 @@ static int bt_gap_event(struct ble_gap_event *event, void *arg) {
     rc = ble_gap_conn_find(event->conn_update.conn_handle, &desc);
     assert(rc == 0);
     MODLOG_DFLT(INFO, "\n");
+    bt_log_conn(event->conn_update.conn_handle);
     return 0;
 
   case BLE_GAP_EVENT_ADV_COMPLETE:
     MODLOG_DFLT(INFO, "advertise complete; reason=%d", event->adv_complete.reason);
-    bt_advertise();
+    // The fast burst ran its course, so carry on slowly
+    if (s_is_enabled) {
+      bt_advertise(event->adv_complete.reason != BLE_HS_ETIMEOUT);
+    }
     return 0;
 
   case BLE_GAP_EVENT_ENC_CHANGE:
@@ -281,6 +474,18 @@ static int bt_gap_event(struct ble_gap_event *event, void *arg) {
                 event->subscribe.conn_handle, event->subscribe.attr_handle, event->subscribe.reason,
                 event->subscribe.prev_notify, event->subscribe.cur_notify,
                 event->subscribe.prev_indicate, event->subscribe.cur_indicate);
+    for (size_t i = 0; i < s_chr_count; i++) {
+      if (s_val_handles[i] != event->subscribe.attr_handle) {
+        continue;
+      }
+      bool was = event->subscribe.prev_notify || event->subscribe.prev_indicate;
+      bool is = event->subscribe.cur_notify || event->subscribe.cur_indicate;
+      if (is && !was) {
+        s_subscribers[i]++;
+      } else if (was && !is && s_subscribers[i] > 0) {
+        s_subscribers[i]--;
+      }
+    }
     return 0;
 
   case BLE_GAP_EVENT_MTU:
@@ -353,7 +558,7 @@ static void bt_on_sync(void) {
   rc = ble_hs_id_copy_addr(s_own_addr_type, addr_val, NULL);
   MODLOG_DFLT(INFO, "\n");
   /* Begin advertising. */
-  bt_advertise();
+  bt_advertise(true);
 }
 
 void bt_host_task(void *param) {
@@ -365,24 +570,38 @@ void bt_host_task(void *param) {
   ESP_ERROR_CHECK(esp_nimble_hci_deinit());
 }
 
-void bt_register(bt_chr chr) {
-  size_t idx = s_chr_entries.size();
-
-  ble_uuid128_t chr_uuid = gatt_svr_chr_base;
-  chr_uuid.value[0] = idx;
+bt_chr_id bt_register(bt_chr chr) {
+  assert(!s_host_initialized && s_chr_count < BT_MAX_CHRS);
+  // Notifications read the value to send
+  assert(chr.readable || !chr.notifiable);
+  assert(chr.writable || !chr.writeNoResponse);
 
-  ble_uuid128_t desc_uuid = gatt_svr_desc_base;
-  desc_uuid.value[0] = idx;
+  ble_gatt_chr_flags flags = 0;
+  if (chr.readable) {
+    flags |= BLE_GATT_CHR_F_READ;
+  }
+  if (chr.writable) {
+    flags |= BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_ENC;
+  }
+  if (chr.writeNoResponse) {
+    flags |= BLE_GATT_CHR_F_WRITE_NO_RSP;
+  }
+  if (chr.notifiable) {
+    flags |= BLE_GATT_CHR_F_NOTIFY | BLE_GATT_CHR_F_INDICATE;
+  }
 
-  s_chr_entries.push_back(bt_chr_entry{
-      .chr_uuid = chr_uuid,
-      .desc_uuid = desc_uuid,
-      .chr = chr,
-      .dscs = {{.att_flags = BLE_ATT_F_READ, .access_cb = gatt_svr_desc_access, .arg = (void *)idx},
-               {0}}});
+  s_gatt_svr_chrs.chrs[s_chr_count].flags = flags;
+  s_chrs[s_chr_count] = chr;
+  return s_chr_count++;
 }
 
 void bt_init() { /* Initialize the NimBLE host configuration. */
+  if (s_host_initialized) {
+    return;
+  }
+
+  ESP_ERROR_CHECK(nimble_port_init());
+
   ble_hs_cfg.reset_cb = bt_on_reset;
   ble_hs_cfg.sync_cb = bt_on_sync;
   ble_hs_cfg.gatts_register_cb = gatt_svr_register_cb;
@@ -394,27 +613,8 @@ void bt_init() { /* Initialize the NimBLE host configuration. */
   ble_svc_gap_init();
   ble_svc_gatt_init();
 
-  for (bt_chr_entry &entry : s_chr_entries) {
-    ble_gatt_chr_flags flags = 0;
-
-    if (entry.chr.readable) {
-      flags |= BLE_GATT_CHR_F_READ;
-    }
-    if (entry.chr.writable) {
-      flags |= BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_ENC;
-    }
-
-    entry.dscs[0].uuid = &entry.desc_uuid.u;
-    s_gatt_svr_chrs.push_back(ble_gatt_chr_def{.uuid = &entry.chr_uuid.u,
-                                               .access_cb = gatt_svr_chr_access,
-                                               .arg = (void *)entry.chr_uuid.value[0],
-                                               .descriptors = entry.dscs,
-                                               .flags = flags});
-  }
-
-  s_gatt_svr_chrs.push_back({0}); // No more characteristics in this service.
-
-  s_gatt_svr_svcs[0].characteristics = &s_gatt_svr_chrs[0];
+  // End the table after the last registration
+  s_gatt_svr_chrs.chrs[s_chr_count] = {0};
   int rc = ble_gatts_count_cfg(s_gatt_svr_svcs);
   assert(rc == 0);
 
@@ -425,19 +625,46 @@ void bt_init() { /* Initialize the NimBLE host configuration. */
   assert(rc == 0);
 
   ble_store_config_init();
+
+  nimble_port_freertos_init(bt_host_task);
+  s_host_initialized = true;
+}
+
+// The main task can't sleep while the controller is running, so instead
+// scale the CPU down to the XTAL frequency whenever it idles between radio
+// events
+static void bt_configure_pm(bool enabled) {
+#if CONFIG_PM_ENABLE
+  esp_pm_config_esp32_t pm = {
+      .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+      .min_freq_mhz = enabled ? CONFIG_XTAL_FREQ : CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+      // Light sleep isn't enabled: the controller vetoes it while its sleep
+      // clock is the main XTAL, and the button only wakes the main task from
+      // light sleep through the RTC wake sources enterSleep sets up
+      .light_sleep_enable = false,
+  };
+  ESP_ERROR_CHECK(esp_pm_configure(&pm));
+#endif
 }
 
 void bt_start() {
   if (bt_is_enabled()) {
     return;
   }
+  s_start_us = esp_timer_get_time();
+  s_is_enabled = true;
+  bt_configure_pm(true);
 
-  ESP_ERROR_CHECK(nimble_port_init());
-
-  bt_init();
+  if (!s_host_initialized) {
+    // The host syncs with the controller and starts advertising once it's up
+    bt_init();
+    return;
+  }
 
-  nimble_port_freertos_init(bt_host_task);
-  s_is_enabled = true;
+  // The host is still running, so bring the controller back and have the host
+  // resync with it, which advertises again
+  ESP_ERROR_CHECK(esp_bt_controller_enable(ESP_BT_MODE_BLE));
+  ble_hs_sched_reset(BLE_HS_ECONTROLLER);
 }
 
 void bt_stop() {
@@ -445,13 +672,72 @@ void bt_stop() {
     return;
   }
   s_is_enabled = false;
-  int ret = nimble_port_stop();
-  if (ret == 0) {
-    ret = nimble_port_deinit();
-    if (ret != ESP_OK) {
-      ESP_LOGE(tag, "nimble_port_deinit() failed with error: %d", ret);
-    }
+  s_start_us = -1;
+  s_notify_pending = 0;
+
+  int rc = ble_gap_adv_stop();
+  if (rc != 0 && rc != BLE_HS_EALREADY) {
+    ESP_LOGE(tag, "ble_gap_adv_stop() failed with error: %d", rc);
   }
+
+  // Let the peers know rather than having them time out
+  for (size_t i = 0; i < s_conn_count; i++) {
+    ble_gap_terminate(s_conn_handles[i], BLE_ERR_REM_USER_CONN_TERM);
+  }
+  for (int waited = 0; s_conn_count > 0 && waited < BT_STOP_TIMEOUT_MS; waited += 10) {
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  s_conn_count = 0;
+  memset(s_subscribers, 0, sizeof(s_subscribers));
+
+  ESP_ERROR_CHECK(esp_bt_controller_disable());
+  bt_configure_pm(false);
 }
 
 bool bt_is_enabled() { return s_is_enabled; }
+
+void bt_notify(bt_chr_id id) {
+  assert(id < s_chr_count && s_chrs[id].notifiable);
+  if (s_is_enabled && s_subscribers[id] > 0) {
+    s_notify_pending |= 1u << id;
+  }
+}
+
+static uint64_t bt_next_notify_millis() {
+  return s_notify_pending == 0 ? UINT64_MAX : s_last_notify_ms + BT_NOTIFY_INTERVAL_MS;
+}
+
+static uint64_t bt_next_idle_millis() {
+  return s_conn_count == 0 || s_conn_idle ? UINT64_MAX : s_last_access_ms + BT_CONN_IDLE_MS;
+}
+
+void bt_poll() {
+  if (millis64() >= bt_next_idle_millis()) {
+    s_conn_idle = true;
+    for (size_t i = 0; i < s_conn_count; i++) {
+      int rc = ble_gap_update_params(s_conn_handles[i], &s_conn_idle_params);
+      if (rc != 0) {
+        ESP_LOGE(tag, "ble_gap_update_params() failed with error: %d", rc);
+      }
+    }
+  }
+
+  if (s_notify_pending == 0 || millis64() < bt_next_notify_millis()) {
+    return;
+  }
+
+  uint32_t pending = s_notify_pending;
+  s_notify_pending = 0;
+  s_last_notify_ms = millis64();
+  for (size_t i = 0; i < s_chr_count; i++) {
+    if (pending & (1u << i)) {
+      // Sends to every subscribed connection, reading the value through
+      // gatt_svr_chr_access
+      ble_gatts_chr_updated(s_val_handles[i]);
+    }
+  }
+}
+
+uint64_t bt_next_update_millis() {
+  return std::min(bt_next_notify_millis(), bt_next_idle_millis());
+}
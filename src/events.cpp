@@ -0,0 +1,49 @@
+#include "events.h"
+
+#include <limits.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "helpers.h"
+
+static TaskHandle_t s_task_handle;
+static uint32_t s_wakeups;
+
+void events_init() { s_task_handle = xTaskGetCurrentTaskHandle(); }
+
+void events_post(uint32_t events) {
+  if (s_task_handle == NULL) {
+    return;
+  }
+  xTaskNotify(s_task_handle, events, eSetBits);
+}
+
+void events_post_from_isr(uint32_t events) {
+  if (s_task_handle == NULL) {
+    return;
+  }
+
+  BaseType_t higher_priority_task_woken = pdFALSE;
+  xTaskNotifyFromISR(s_task_handle, events, eSetBits, &higher_priority_task_woken);
+  if (higher_priority_task_woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+uint32_t events_wait(uint64_t deadline_ms) {
+  uint64_t now = millis64();
+  TickType_t ticks = 0;
+  if (deadline_ms > now) {
+    // Round up so we never wake before the deadline and spin
+    ticks = (deadline_ms - now + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+  }
+
+  uint32_t events = 0;
+  xTaskNotifyWait(0, ULONG_MAX, &events, ticks);
+  s_wakeups++;
+
+  return events;
+}
+
+uint32_t events_wakeup_count() { return s_wakeups; }
@@ -3,3 +3,9 @@
 #include "esp_timer.h"
 
 uint64_t millis64() { return esp_timer_get_time() / 1000; };
+
+static uint64_t s_slept_ms;
+
+uint64_t awake_millis64() { return millis64() - s_slept_ms; }
+
+void record_sleep_millis(uint64_t sleep_ms) { s_slept_ms += sleep_ms; }
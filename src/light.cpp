@@ -4,23 +4,40 @@
 
 #include "driver/ledc.h"
 #include "esp_log.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/timers.h"
 
+#include "Gamma.h"
+#include "events.h"
 #include "helpers.h"
 
 #define LED_R_GPIO GPIO_NUM_27
 #define LED_G_GPIO GPIO_NUM_14
 #define LED_B_GPIO GPIO_NUM_15
 
+#define LEDC_FREQ_HZ 1000
+// The LEDC fade unit can hold each duty step for at most this many PWM cycles
+#define LEDC_MAX_CYCLES_PER_STEP 1023
+// The fade unit only ramps linearly, so each fade follows the gamma curve as
+// this many linear segments.
+#define FADE_SEGMENTS 8
+
+static const gpio_num_t s_pins[3] = {LED_R_GPIO, LED_G_GPIO, LED_B_GPIO};
+
+// Fades are linear in 8.8 fixed point brightness level, not duty
+struct Fade {
+  uint16_t start_level;
+  uint16_t target_level;
+  uint64_t start_ms;
+  uint64_t end_ms;
+  // When light_poll should start the next segment, 0 once the fade is done
+  uint64_t next_segment_ms;
+};
+
+static Fade s_fades[3];
 static uint64_t s_end_ms;
+static uint64_t s_fade_start_awake_ms;
 static uint8_t s_target_color[3];
-static double s_delta_per_ms[3];
 
-static StaticTimer_t s_fade_timer;
-static TimerHandle_t s_fade_timer_handle;
-
-bool is_on(uint8_t color[3]) {
+bool is_on(const uint8_t color[3]) {
   for (size_t i = 0; i < 3; i++) {
     if (color[i] != 0) {
       return true;
@@ -29,79 +46,134 @@ bool is_on(uint8_t color[3]) {
   return false;
 }
 
-void fade_timer_cb(TimerHandle_t xTimer) {
-  uint64_t now = millis64();
-  bool done = now >= s_end_ms;
+static void set_duty(size_t channel, uint32_t duty) {
+  ESP_ERROR_CHECK(ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, (ledc_channel_t)channel, duty, 0));
+}
 
-  for (size_t i = 0; i < 3; i++) {
-    uint8_t duty;
-    if (done) {
-      duty = s_target_color[i];
-    } else {
-      duty = s_target_color[i] - s_delta_per_ms[i] * (s_end_ms - now);
-    }
-    ESP_ERROR_CHECK(ledc_set_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)i, duty));
-    ESP_ERROR_CHECK(ledc_update_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)i));
+static uint16_t level_at(const Fade &fade, uint64_t now) {
+  if (now >= fade.end_ms) {
+    return fade.target_level;
   }
+  return gamma_fade_level(fade.start_level, fade.target_level, now - fade.start_ms,
+                          fade.end_ms - fade.start_ms);
+}
 
-  if (done) {
-    s_end_ms = 0;
-    xTimerStop(s_fade_timer_handle, 0);
+static void start_segment(size_t channel, uint64_t now) {
+  Fade &fade = s_fades[channel];
+  uint32_t duty = gamma_duty(level_at(fade, now));
+
+  ledc_fade_stop(LEDC_LOW_SPEED_MODE, (ledc_channel_t)channel);
+  set_duty(channel, duty);
+  if (now >= fade.end_ms) {
+    fade.next_segment_ms = 0;
+    return;
   }
+
+  uint64_t segment_end =
+      std::min(fade.end_ms, now + std::max<uint64_t>((fade.end_ms - fade.start_ms) / FADE_SEGMENTS, 1));
+  uint32_t segment_duty = gamma_duty(level_at(fade, segment_end));
+  uint32_t segment_ms = segment_end - now;
+  uint32_t steps = abs((int)segment_duty - (int)duty);
+
+  if (steps > 0 && segment_ms * LEDC_FREQ_HZ / 1000 / steps <= LEDC_MAX_CYCLES_PER_STEP) {
+    // The segment runs in hardware, including while we light sleep
+    ESP_ERROR_CHECK(ledc_set_fade_with_time(LEDC_LOW_SPEED_MODE, (ledc_channel_t)channel,
+                                            segment_duty, segment_ms));
+    ESP_ERROR_CHECK(
+        ledc_fade_start(LEDC_LOW_SPEED_MODE, (ledc_channel_t)channel, LEDC_FADE_NO_WAIT));
+  } else if (steps > 0) {
+    // Too slow for the fade unit, so step the duty from light_poll instead
+    segment_end = now + segment_ms / steps;
+  }
+  fade.next_segment_ms = segment_end;
 }
 
 void light_setup() {
   ledc_timer_config_t ledc_timer = {.speed_mode = LEDC_LOW_SPEED_MODE,
-                                    .duty_resolution = LEDC_TIMER_8_BIT,
+                                    .duty_resolution = (ledc_timer_bit_t)GAMMA_DUTY_BITS,
                                     .timer_num = LEDC_TIMER_0,
-                                    .freq_hz = 1000,
+                                    .freq_hz = LEDC_FREQ_HZ,
                                     .clk_cfg = LEDC_USE_RTC8M_CLK};
   ESP_ERROR_CHECK(ledc_timer_config(&ledc_timer));
 
-  gpio_num_t pins[3] = {LED_R_GPIO, LED_G_GPIO, LED_B_GPIO};
   for (int i = 0; i < 3; i++) {
-    ledc_channel_config_t ledc_channel = {.gpio_num = pins[i],
+    // Release any hold left over from deep sleep
+    ESP_ERROR_CHECK(gpio_hold_dis(s_pins[i]));
+
+    ledc_channel_config_t ledc_channel = {.gpio_num = s_pins[i],
                                           .speed_mode = LEDC_LOW_SPEED_MODE,
                                           .channel = (ledc_channel_t)i,
                                           .intr_type = LEDC_INTR_DISABLE,
                                           .timer_sel = LEDC_TIMER_0,
-                                          .duty = s_target_color[i],
+                                          .duty = gamma_duty(GAMMA_LEVEL(s_target_color[i])),
                                           .hpoint = 0,
                                           .flags = {}};
     ESP_ERROR_CHECK(ledc_channel_config(&ledc_channel));
   }
 
-  s_fade_timer_handle = xTimerCreateStatic("light_fade", pdMS_TO_TICKS(10), pdTRUE, NULL,
-                                           fade_timer_cb, &s_fade_timer);
+  ESP_ERROR_CHECK(ledc_fade_func_install(0));
 }
 
-void light_set_color(uint8_t color[3], size_t fade_ms_per_step) {
-  xTimerStop(s_fade_timer_handle, portMAX_DELAY);
-
+void light_set_color(const uint8_t color[3], size_t fade_ms_per_step) {
   uint64_t now = millis64();
-  uint8_t max_delta = 0;
+  uint16_t start_level[3];
+  uint32_t max_delta = 0;
   for (size_t i = 0; i < 3; i++) {
-    uint8_t start_color = ledc_get_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)i);
+    // Start from wherever an interrupted fade had got to
+    start_level[i] = level_at(s_fades[i], now);
     s_target_color[i] = color[i];
-    s_delta_per_ms[i] = (double)((int64_t)s_target_color[i] - start_color);
 
-    max_delta = std::max(max_delta, (uint8_t)abs((int)s_target_color[i] - start_color));
+    max_delta = std::max(max_delta, (uint32_t)abs(GAMMA_LEVEL(color[i]) - start_level[i]));
   }
 
-  s_end_ms = now + max_delta * fade_ms_per_step;
+  uint32_t duration_ms = (max_delta * fade_ms_per_step) >> 8;
+  s_end_ms = duration_ms > 0 ? now + duration_ms : 0;
+  s_fade_start_awake_ms = awake_millis64();
   ESP_LOGI("APP", "setColor: R%03d|G%03d|B%03d now:%llu end:%llu\n", color[0], color[1], color[2],
            now, s_end_ms);
 
-  if (fade_ms_per_step == 0) {
-    s_end_ms = 0;
-    fade_timer_cb(NULL);
-  } else {
-    for (size_t i = 0; i < 3; i++) {
-      s_delta_per_ms[i] /= (s_end_ms - now);
+  for (size_t i = 0; i < 3; i++) {
+    s_fades[i] = Fade{.start_level = start_level[i],
+                      .target_level = GAMMA_LEVEL(color[i]),
+                      .start_ms = now,
+                      .end_ms = now + duration_ms,
+                      .next_segment_ms = 0};
+    start_segment(i, now);
+  }
+
+  // The fade may have been started from another task so make sure the main
+  // task picks up the new deadlines.
+  events_post(EVENT_LIGHT);
+}
+
+void light_poll() {
+  uint64_t now = millis64();
+
+  for (size_t i = 0; i < 3; i++) {
+    if (s_fades[i].next_segment_ms > 0 && s_fades[i].next_segment_ms <= now) {
+      start_segment(i, now);
     }
+  }
+
+  if (s_end_ms > 0 && now >= s_end_ms) {
+    ESP_LOGI("APP", "fade done in %llums, CPU awake %llums", now - s_fades[0].start_ms,
+             awake_millis64() - s_fade_start_awake_ms);
+    s_end_ms = 0;
+  }
+}
+
+uint64_t light_next_update_millis() {
+  if (s_end_ms == 0) {
+    return UINT64_MAX;
+  }
 
-    xTimerStart(s_fade_timer_handle, 0);
+  uint64_t next = s_end_ms;
+  for (size_t i = 0; i < 3; i++) {
+    if (s_fades[i].next_segment_ms > 0) {
+      next = std::min(next, s_fades[i].next_segment_ms);
+    }
   }
+  return next;
 }
 
 void light_get_color(uint8_t *color) {
@@ -110,19 +182,47 @@ void light_get_color(uint8_t *color) {
   }
 }
 
-void light_toggle(uint fade_ms_per_step, uint8_t last_update_color[3]) {
-  uint8_t *next_color;
+void light_get_current_color(uint8_t *color) {
+  uint64_t now = millis64();
+  for (size_t i = 0; i < 3; i++) {
+    // Round the 8.8 fixed point level to the nearest whole one
+    color[i] = std::min((level_at(s_fades[i], now) + 0x80) >> 8, 0xff);
+  }
+}
+
+uint8_t light_fade_progress() {
+  uint64_t now = millis64();
+  if (s_end_ms == 0 || now >= s_end_ms) {
+    return 0xff;
+  }
+  const Fade &fade = s_fades[0];
+  return (now - fade.start_ms) * 0xff / (fade.end_ms - fade.start_ms);
+}
+
+void light_toggle(uint fade_ms_per_step, const uint8_t last_update_color[3]) {
+  const uint8_t *next_color;
 
   if (is_on(s_target_color)) {
-    next_color = LIGHT_COLOR_OFF;
+    next_color = LIGHT_COLOR_OFF.data();
   } else {
     if (is_on(last_update_color)) {
       next_color = last_update_color;
     } else {
-      next_color = LIGHT_COLOR_WHITE;
+      next_color = LIGHT_COLOR_WHITE.data();
     }
   }
   light_set_color(next_color, fade_ms_per_step);
 }
 
 bool light_is_fading() { return s_end_ms > 0; }
+
+bool light_is_on() { return is_on(s_target_color); }
+
+void light_hold_off() {
+  // LEDC doesn't run in deep sleep so latch the pins at their current (zero
+  // duty) level instead of letting them float.
+  for (size_t i = 0; i < 3; i++) {
+    ESP_ERROR_CHECK(gpio_hold_en(s_pins[i]));
+  }
+  gpio_deep_sleep_hold_en();
+}
@@ -7,6 +7,7 @@
 #include "esp_log.h"
 #include "esp_sleep.h"
 #include "esp_task_wdt.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "nvs_flash.h"
 #include "soc/rtc.h"
@@ -14,6 +15,7 @@
 #include <algorithm>
 #include <iterator>
 #include <string.h>
+#include <sys/time.h>
 #include <vector>
 
 #include "Button.h"
@@ -22,19 +24,31 @@
 #include "Power.h"
 #include "app_config.h"
 #include "bt.h"
+#include "events.h"
 #include "helpers.h"
 #include "light.h"
 #include "network_time_manager.h"
+#include "ota.h"
+#include "radio.h"
 #include "wifi_credentials.h"
+#include "worker.h"
 
 #define ACTION_FADE_MS_PER_STEP 118 // ~30s (1000 * 30 / 255)
 #define BUTTON_FADE_MS_PER_STEP 4   // ~1 second
 #define BUTTON_HOLD_MS 5 * 1000
-#define ERROR_SLEEP_DURATION_S 60 * 30
 #define WAKE_ON_MINS 60
 #define NAP_MINS 90
 #define PRESLEEP_MINS 60
-
+// Wake at least this often so the task watchdog stays fed
+#define MAX_WAIT_MS (CONFIG_ESP_TASK_WDT_TIMEOUT_S * 1000 / 2)
+#define WAKEUP_REPORT_INTERVAL_SECS 60
+#define RTC_SNAPSHOT_MAGIC 0x77616b65 // "wake"
+// Clients write the SSID and password one after the other, so wait this long
+// after the last write to reconnect once with both
+#define WIFI_CREDENTIALS_SETTLE_MS 1000
+
+// Every profile starts with these actions, which are the ones editable over
+// Bluetooth. Any day-specific actions follow them.
 #define WAKE_IDX 0
 #define WAKE_OFF_IDX WAKE_IDX + 1
 #define NAP_IDX WAKE_OFF_IDX + 1
@@ -45,22 +59,159 @@
 
 #define BUTTON_GPIO GPIO_NUM_4
 
+// The schedule characteristic packs the active profile into one value: a
+// format version, the profile's name (zero padded), its action count, then
+// its actions as LightManager::encode lays them out. It's larger than the
+// default MTU, so clients either negotiate a bigger one or use long reads and
+// writes. The device holds at most LIGHT_MANAGER_MAX_ACTIONS (24) actions per
+// profile, and a longer schedule is refused with BT_ERR_INVALID_LENGTH.
+#define SCHEDULE_FORMAT_VERSION 1
+#define SCHEDULE_HEADER_SIZE (2 + LIGHT_MANAGER_PROFILE_NAME_SIZE)
+#define SCHEDULE_MAX_SIZE                                                                          \
+  (SCHEDULE_HEADER_SIZE + LIGHT_MANAGER_MAX_ACTIONS * LIGHT_MANAGER_ACTION_SIZE)
+
+// The light state characteristic, for clients to follow by notification: the
+// current color, the color being faded to, the fade progress (255 when done)
+// and the next transition in seconds since the epoch (u32 little endian, 0 if
+// unknown). Small enough for one notification at the default MTU.
+#define LIGHT_STATE_SIZE 11
+
 // Config
-std::vector<LightManager::Action> actions;
+LightManager::Profiles profiles;
 char wifi_ssid[APP_CONFIG_WIFI_SSID_SIZE];
 char wifi_pswd[APP_CONFIG_WIFI_PSWD_SIZE];
 
-LightManager lightManager(actions);
+LightManager lightManager(profiles);
 Button button(BUTTON_GPIO, BUTTON_HOLD_MS, BUTTON_HOLD_MS);
 Dotstar dotstar;
 Power power;
 
+// State needed to resume the schedule after a deep sleep timer wake without
+// touching NVS or WiFi. Actions use the same encoding as NVS.
+struct RtcSnapshot {
+  uint32_t magic;
+  char profileName[LIGHT_MANAGER_PROFILE_NAME_SIZE];
+  uint8_t actionsSize;
+  uint8_t actions[LIGHT_MANAGER_MAX_ACTIONS * LIGHT_MANAGER_ACTION_SIZE];
+  static_assert(sizeof(actions) <= UINT8_MAX, "actionsSize is a byte");
+  uint8_t lastUpdateColor[3];
+  time_t nextLightUpdate;
+  char posixTz[NTM_POSIX_TZ_SIZE];
+};
+RTC_DATA_ATTR RtcSnapshot rtcSnapshot;
+
+bool initialized;
 uint64_t nextLightUpdateMillis;
+uint64_t nextWakeupReportMillis;
+uint32_t lastWakeupCount;
 uint8_t lastUpdateColor[3];
 bool btWroteColor;
+// Set by the Bluetooth host task, then handled on the main task by
+// applyWifiCredentials
+volatile bool btWroteWifiCredentials;
+uint64_t applyWifiCredentialsMillis;
 
 char color_access_buf[12];
 char time_access_buf[6];
+char profile_access_buf[LIGHT_MANAGER_PROFILE_NAME_SIZE];
+char schedule_access_buf[SCHEDULE_MAX_SIZE];
+char light_state_buf[LIGHT_STATE_SIZE];
+
+bt_chr_id currentLightChr;
+bt_chr_id lightStateChr;
+// What subscribers were last told, to only notify them of changes. The
+// Bluetooth host task reads publishedUpdateMillis rather than
+// nextLightUpdateMillis, under publishedLock since a 64-bit read can tear.
+uint8_t publishedColor[3];
+uint64_t publishedUpdateMillis;
+portMUX_TYPE publishedLock = portMUX_INITIALIZER_UNLOCKED;
+bool publishedFading;
+
+// Schedule edits made over Bluetooth. The host task reads and edits this copy
+// of the profiles, and the main task applies what changed in
+// applyScheduleEdits, so `profiles` and `lightManager` are only ever touched by
+// the task that updates the light.
+struct ScheduleEdits {
+  LightManager::Profiles profiles;
+  size_t active;
+  // Bitmask of the profiles changed since they were last applied
+  uint8_t changedProfiles;
+  bool activeChanged;
+  // Apply the schedule now rather than at the next transition
+  bool updateNow;
+  bool colorChanged;
+  uint8_t color[3];
+};
+static_assert(LIGHT_MANAGER_MAX_PROFILES <= 8, "changedProfiles is a byte");
+ScheduleEdits scheduleEdits;
+portMUX_TYPE scheduleEditsLock = portMUX_INITIALIZER_UNLOCKED;
+
+LightManager::Actions &activeActions() {
+  return profiles[lightManager.profile()].actions;
+}
+
+// Must be called with scheduleEditsLock held
+LightManager::Actions &editedActiveActions() {
+  return scheduleEdits.profiles[scheduleEdits.active].actions;
+}
+
+// Must be called with scheduleEditsLock held
+void markActiveProfileEdited() {
+  scheduleEdits.changedProfiles |= 1 << scheduleEdits.active;
+}
+
+// Gives the host task a fresh copy of the schedule to serve. Call on the main
+// task before starting Bluetooth.
+void copyScheduleForEdits() {
+  portENTER_CRITICAL(&scheduleEditsLock);
+  scheduleEdits = ScheduleEdits{};
+  scheduleEdits.profiles = profiles;
+  scheduleEdits.active = lightManager.profile();
+  portEXIT_CRITICAL(&scheduleEditsLock);
+}
+
+// Applies schedule edits made over Bluetooth, and stages them to be saved
+void applyScheduleEdits() {
+  LightManager::Profiles &edited = scheduleEdits.profiles;
+  portENTER_CRITICAL(&scheduleEditsLock);
+  uint8_t changedProfiles = scheduleEdits.changedProfiles;
+  bool activeChanged = scheduleEdits.activeChanged;
+  bool updateNow = scheduleEdits.updateNow;
+  bool colorChanged = scheduleEdits.colorChanged;
+  uint8_t color[3];
+  std::copy(scheduleEdits.color, std::end(scheduleEdits.color), color);
+  size_t active = scheduleEdits.active;
+  for (size_t i = 0; i < edited.size(); i++) {
+    if (changedProfiles & (1 << i)) {
+      profiles[i] = edited[i];
+    }
+  }
+  scheduleEdits.changedProfiles = 0;
+  scheduleEdits.activeChanged = false;
+  scheduleEdits.updateNow = false;
+  scheduleEdits.colorChanged = false;
+  portEXIT_CRITICAL(&scheduleEditsLock);
+
+  for (size_t i = 0; i < profiles.size(); i++) {
+    if (changedProfiles & (1 << i)) {
+      config_set_profile(i, profiles[i]);
+    }
+  }
+  if (changedProfiles != 0) {
+    lightManager.invalidate();
+  }
+  if (activeChanged) {
+    lightManager.setProfile(active);
+    config_set_active_profile(active);
+  }
+  if (updateNow) {
+    nextLightUpdateMillis = 0;
+  }
+  if (colorChanged) {
+    light_set_color(color, BUTTON_FADE_MS_PER_STEP);
+    btWroteColor = true;
+  }
+}
 
 // TODO: Write tests for this
 size_t strSplitToUL(const char *str, size_t strN, uint8_t *dest, size_t destN,
@@ -109,6 +260,7 @@ int wifiSsidAccessCb(size_t *bytes, const bt_chr *chr, BtOp op) {
   int ret = strAccessCb(bytes, chr, op);
   if (op == BtOp::WRITTEN) {
     config_set_ssid(wifi_ssid);
+    btWroteWifiCredentials = true;
   }
 
   return ret;
@@ -118,6 +270,7 @@ int wifiPswdAccessCb(size_t *bytes, const bt_chr *chr, BtOp op) {
   int ret = strAccessCb(bytes, chr, op);
   if (op == BtOp::WRITTEN) {
     config_set_pswd(wifi_pswd);
+    btWroteWifiCredentials = true;
   }
 
   return ret;
@@ -140,13 +293,13 @@ int colorAccessCb(size_t *bytes, const bt_chr *chr, BtOp op) {
       return 1;
     }
 
-    light_set_color(color, BUTTON_FADE_MS_PER_STEP);
-    for (size_t i = 0; i < sizeof(color); i++) {
-      (*actions.at(PRESLEEP_IDX).color)[i] = color[i];
-    }
-
-    btWroteColor = true;
-    config_set_actions(actions);
+    portENTER_CRITICAL(&scheduleEditsLock);
+    std::copy(color, std::end(color), editedActiveActions().at(PRESLEEP_IDX).color.begin());
+    markActiveProfileEdited();
+    std::copy(color, std::end(color), scheduleEdits.color);
+    scheduleEdits.colorChanged = true;
+    portEXIT_CRITICAL(&scheduleEditsLock);
+    events_post(EVENT_CONFIG);
 
     break;
   }
@@ -189,59 +342,125 @@ void setNextTime(LightManager::HrMin *time, LightManager::HrMin *next,
   }
 }
 
+// Reads the time in `slot` of the active profile, as the host task sees it
+LightManager::HrMin editedTime(size_t slot) {
+  portENTER_CRITICAL(&scheduleEditsLock);
+  LightManager::HrMin time = editedActiveActions()[slot].time;
+  portEXIT_CRITICAL(&scheduleEditsLock);
+  return time;
+}
+
 int presleepTimeAccessCb(size_t *bytes, const bt_chr *chr, BtOp op) {
-  LightManager::HrMin *presleep = &actions[PRESLEEP_IDX].time;
+  LightManager::HrMin presleep = editedTime(PRESLEEP_IDX);
 
-  if (timeAccessCb(bytes, chr, op, presleep) != 0) {
+  if (timeAccessCb(bytes, chr, op, &presleep) != 0) {
     return 1;
   }
   if (op == BtOp::WRITTEN) {
-    LightManager::HrMin *sleep = &actions[SLEEP_IDX].time;
-    setNextTime(presleep, sleep, PRESLEEP_MINS);
-
-    config_set_actions(actions);
-    ESP_LOGI("APP", "Set presleep %02d:%02d, sleep %02d:%02d", presleep->hour,
-             presleep->minute, sleep->hour, sleep->minute);
+    LightManager::HrMin sleep;
+    setNextTime(&presleep, &sleep, PRESLEEP_MINS);
+
+    portENTER_CRITICAL(&scheduleEditsLock);
+    editedActiveActions()[PRESLEEP_IDX].time = presleep;
+    editedActiveActions()[SLEEP_IDX].time = sleep;
+    markActiveProfileEdited();
+    portEXIT_CRITICAL(&scheduleEditsLock);
+    events_post(EVENT_CONFIG);
+    ESP_LOGI("APP", "Set presleep %02d:%02d, sleep %02d:%02d", presleep.hour,
+             presleep.minute, sleep.hour, sleep.minute);
   }
 
   return 0;
 }
 
 int napTimeAccessCb(size_t *bytes, const bt_chr *chr, BtOp op) {
-  LightManager::HrMin *nap = &actions[NAP_IDX].time;
+  LightManager::HrMin nap = editedTime(NAP_IDX);
 
-  if (timeAccessCb(bytes, chr, op, nap) != 0) {
+  if (timeAccessCb(bytes, chr, op, &nap) != 0) {
     return 1;
   }
   if (op == BtOp::WRITTEN) {
-    LightManager::HrMin *wake = &actions[NAP_WAKE_IDX].time;
-    LightManager::HrMin *off = &actions[NAP_OFF_IDX].time;
-
-    setNextTime(nap, wake, NAP_MINS);
-    setNextTime(wake, off, WAKE_ON_MINS);
-
-    config_set_actions(actions);
+    LightManager::HrMin wake, off;
+    setNextTime(&nap, &wake, NAP_MINS);
+    setNextTime(&wake, &off, WAKE_ON_MINS);
+
+    portENTER_CRITICAL(&scheduleEditsLock);
+    editedActiveActions()[NAP_IDX].time = nap;
+    editedActiveActions()[NAP_WAKE_IDX].time = wake;
+    editedActiveActions()[NAP_OFF_IDX].time = off;
+    markActiveProfileEdited();
+    portEXIT_CRITICAL(&scheduleEditsLock);
+    events_post(EVENT_CONFIG);
     ESP_LOGI("APP", "Set nap %02d:%02d, wake %02d:%02d, off %02d:%02d",
-             nap->hour, nap->minute, wake->hour, wake->minute, off->hour,
-             off->minute);
+             nap.hour, nap.minute, wake.hour, wake.minute, off.hour,
+             off.minute);
   }
 
   return 0;
 }
 
 int wakeTimeAccessCb(size_t *bytes, const bt_chr *chr, BtOp op) {
-  LightManager::HrMin *wake = &actions[WAKE_IDX].time;
+  LightManager::HrMin wake = editedTime(WAKE_IDX);
 
-  if (timeAccessCb(bytes, chr, op, wake) != 0) {
+  if (timeAccessCb(bytes, chr, op, &wake) != 0) {
     return 1;
   }
   if (op == BtOp::WRITTEN) {
-    LightManager::HrMin *off = &actions[WAKE_OFF_IDX].time;
-    setNextTime(wake, off, WAKE_ON_MINS);
+    LightManager::HrMin off;
+    setNextTime(&wake, &off, WAKE_ON_MINS);
+
+    portENTER_CRITICAL(&scheduleEditsLock);
+    editedActiveActions()[WAKE_IDX].time = wake;
+    editedActiveActions()[WAKE_OFF_IDX].time = off;
+    markActiveProfileEdited();
+    portEXIT_CRITICAL(&scheduleEditsLock);
+    events_post(EVENT_CONFIG);
+    ESP_LOGI("APP", "Set wake %02d:%02d, off %02d:%02d", wake.hour,
+             wake.minute, off.hour, off.minute);
+  }
+
+  return 0;
+}
+
+// The index of the profile named `name` in `candidates`, or -1 if there's none
+int findProfile(const LightManager::Profiles &candidates, const char *name) {
+  for (size_t i = 0; i < candidates.size(); i++) {
+    if (strncmp(candidates[i].name, name, LIGHT_MANAGER_PROFILE_NAME_SIZE) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int profileAccessCb(size_t *bytes, const bt_chr *chr, BtOp op) {
+  switch (op) {
+  case BtOp::REQUEST_READ: {
+    char name[LIGHT_MANAGER_PROFILE_NAME_SIZE];
+    portENTER_CRITICAL(&scheduleEditsLock);
+    strlcpy(name, scheduleEdits.profiles[scheduleEdits.active].name, sizeof(name));
+    portEXIT_CRITICAL(&scheduleEditsLock);
+    *bytes = snprintf(chr->buffer, chr->bufferSize, "%s", name);
+    break;
+  }
+  case BtOp::WRITTEN: {
+    chr->buffer[*bytes] = 0;
+    portENTER_CRITICAL(&scheduleEditsLock);
+    int idx = findProfile(scheduleEdits.profiles, chr->buffer);
+    if (idx >= 0) {
+      scheduleEdits.active = idx;
+      scheduleEdits.activeChanged = true;
+      scheduleEdits.updateNow = true; // Apply the new profile immediately
+    }
+    portEXIT_CRITICAL(&scheduleEditsLock);
+    if (idx < 0) {
+      ESP_LOGE("APP", "Unknown profile: %s", chr->buffer);
+      return 1;
+    }
 
-    config_set_actions(actions);
-    ESP_LOGI("APP", "Set wake %02d:%02d, off %02d:%02d", wake->hour,
-             wake->minute, off->hour, off->minute);
+    events_post(EVENT_CONFIG);
+    ESP_LOGI("APP", "Set profile %s", chr->buffer);
+    break;
+  }
   }
 
   return 0;
@@ -267,6 +486,180 @@ int currentTimeAccessCb(size_t *bytes, const bt_chr *chr, BtOp op) {
   return 0;
 }
 
+int scheduleAccessCb(size_t *bytes, const bt_chr *chr, BtOp op) {
+  uint8_t *buf = (uint8_t *)chr->buffer;
+  switch (op) {
+  case BtOp::REQUEST_READ: {
+    portENTER_CRITICAL(&scheduleEditsLock);
+    const LightManager::Profile &profile = scheduleEdits.profiles[scheduleEdits.active];
+    buf[0] = SCHEDULE_FORMAT_VERSION;
+    strncpy((char *)buf + 1, profile.name, LIGHT_MANAGER_PROFILE_NAME_SIZE);
+    buf[1 + LIGHT_MANAGER_PROFILE_NAME_SIZE] = profile.actions.size();
+    *bytes = SCHEDULE_HEADER_SIZE + LightManager::encode(profile.actions,
+                                                         buf + SCHEDULE_HEADER_SIZE);
+    portEXIT_CRITICAL(&scheduleEditsLock);
+    break;
+  }
+  case BtOp::WRITTEN: {
+    LightManager::Actions actions;
+    if (*bytes >= SCHEDULE_HEADER_SIZE &&
+        buf[1 + LIGHT_MANAGER_PROFILE_NAME_SIZE] > LIGHT_MANAGER_MAX_ACTIONS) {
+      ESP_LOGE("APP", "Schedule of %d actions is over the limit of %d",
+               buf[1 + LIGHT_MANAGER_PROFILE_NAME_SIZE], LIGHT_MANAGER_MAX_ACTIONS);
+      return BT_ERR_INVALID_LENGTH;
+    }
+    // The fixed slots the other characteristics edit, WAKE_IDX to SLEEP_IDX,
+    // must all be there
+    if (*bytes < SCHEDULE_HEADER_SIZE || buf[0] != SCHEDULE_FORMAT_VERSION ||
+        *bytes - SCHEDULE_HEADER_SIZE !=
+            buf[1 + LIGHT_MANAGER_PROFILE_NAME_SIZE] * (size_t)LIGHT_MANAGER_ACTION_SIZE ||
+        !LightManager::decode(buf + SCHEDULE_HEADER_SIZE, *bytes - SCHEDULE_HEADER_SIZE,
+                              actions) ||
+        actions.size() < SLEEP_IDX + 1) {
+      ESP_LOGE("APP", "Invalid schedule of %zu bytes", *bytes);
+      return 1;
+    }
+    for (const LightManager::Action &action : actions) {
+      if (action.time.hour >= 24 || action.time.minute >= 60 || action.days == 0) {
+        ESP_LOGE("APP", "Invalid schedule action %02d:%02d days 0x%02x", action.time.hour,
+                 action.time.minute, action.days);
+        return 1;
+      }
+    }
+
+    char name[LIGHT_MANAGER_PROFILE_NAME_SIZE];
+    strncpy(name, (char *)buf + 1, sizeof(name));
+    name[sizeof(name) - 1] = 0;
+    // Decoded and checked above, so only the copy is made under the lock. The
+    // main task applies it in applyScheduleEdits.
+    portENTER_CRITICAL(&scheduleEditsLock);
+    int idx = findProfile(scheduleEdits.profiles, name);
+    if (idx >= 0) {
+      if ((size_t)idx != scheduleEdits.active) {
+        scheduleEdits.active = idx;
+        scheduleEdits.activeChanged = true;
+      }
+      editedActiveActions() = actions;
+      markActiveProfileEdited();
+      scheduleEdits.updateNow = true; // Apply the new schedule immediately
+    }
+    portEXIT_CRITICAL(&scheduleEditsLock);
+    if (idx < 0) {
+      ESP_LOGE("APP", "Unknown profile: %s", name);
+      return 1;
+    }
+    events_post(EVENT_CONFIG);
+    ESP_LOGI("APP", "Set profile %s with %zu actions", name, actions.size());
+    break;
+  }
+  }
+
+  return 0;
+}
+
+time_t transitionTime(uint64_t updateMillis);
+time_t nextTransitionTime();
+
+int lightStateAccessCb(size_t *bytes, const bt_chr *chr, BtOp op) {
+  uint8_t *buf = (uint8_t *)chr->buffer;
+  light_get_current_color(buf);
+  light_get_color(buf + 3);
+  buf[6] = light_fade_progress();
+  portENTER_CRITICAL(&publishedLock);
+  uint64_t updateMillis = publishedUpdateMillis;
+  portEXIT_CRITICAL(&publishedLock);
+  struct tm timeinfo;
+  uint32_t next = ntm_get_local_time(&timeinfo) ? transitionTime(updateMillis) : 0;
+  for (size_t i = 0; i < 4; i++) {
+    buf[7 + i] = next >> (8 * i);
+  }
+  *bytes = LIGHT_STATE_SIZE;
+
+  return 0;
+}
+
+bool saveSnapshot() {
+  if (!ntm_get_posix_tz(rtcSnapshot.posixTz)) {
+    return false;
+  }
+
+  strlcpy(rtcSnapshot.profileName, profiles[lightManager.profile()].name,
+          sizeof(rtcSnapshot.profileName));
+  rtcSnapshot.actionsSize = LightManager::encode(activeActions(), rtcSnapshot.actions);
+  std::copy(lastUpdateColor, std::end(lastUpdateColor),
+            rtcSnapshot.lastUpdateColor);
+  // The light's own deadline, not the sleep's, which may be an earlier wake
+  // for the radio or a report
+  rtcSnapshot.nextLightUpdate = nextTransitionTime();
+  rtcSnapshot.magic = RTC_SNAPSHOT_MAGIC;
+
+  return true;
+}
+
+bool restoreSnapshot() {
+  if (rtcSnapshot.magic != RTC_SNAPSHOT_MAGIC) {
+    return false;
+  }
+  // Only resume from a given snapshot once
+  rtcSnapshot.magic = 0;
+
+  profiles.resize(1);
+  LightManager::Profile &profile = profiles[0];
+  strlcpy(profile.name, rtcSnapshot.profileName, sizeof(profile.name));
+  if (!LightManager::decode(rtcSnapshot.actions, rtcSnapshot.actionsSize, profile.actions)) {
+    return false;
+  }
+  lightManager.setProfile((size_t)0);
+  lightManager.invalidate();
+
+  std::copy(rtcSnapshot.lastUpdateColor,
+            std::end(rtcSnapshot.lastUpdateColor), lastUpdateColor);
+
+  ntm_init_offline(rtcSnapshot.posixTz);
+
+  time_t now = time(NULL);
+  nextLightUpdateMillis = millis64();
+  if (rtcSnapshot.nextLightUpdate > now) {
+    nextLightUpdateMillis += (rtcSnapshot.nextLightUpdate - now) * 1000;
+  }
+
+  return true;
+}
+
+// Loads config and brings up the network time manager. This is deferred after
+// resuming from deep sleep until something actually needs it.
+void initialize() {
+  if (initialized) {
+    return;
+  }
+
+  // Initialize NVS
+  esp_err_t ret = nvs_flash_init();
+  if (ret == ESP_ERR_NVS_NO_FREE_PAGES ||
+      ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+    ESP_ERROR_CHECK(nvs_flash_erase());
+    ret = nvs_flash_init();
+  }
+  ESP_ERROR_CHECK(ret);
+
+  ESP_LOGI("APP", "Loading config");
+  uint8_t active_profile;
+  int64_t loadStart = esp_timer_get_time();
+  config_load(profiles, &active_profile, wifi_ssid, wifi_pswd);
+  int64_t loadUs = esp_timer_get_time() - loadStart;
+  lightManager.setProfile(active_profile);
+  lightManager.invalidate();
+  ESP_LOGI("APP", "Loaded in %lldus SSID: %s Pass: %s Profile: %s Wake time: %02d:%02d",
+           loadUs, wifi_ssid, wifi_pswd, profiles[lightManager.profile()].name,
+           activeActions()[WAKE_IDX].time.hour,
+           activeActions()[WAKE_IDX].time.minute);
+
+  ESP_LOGI("APP", "Initializing network time manager");
+  ntm_init();
+
+  initialized = true;
+}
+
 // TODO: Handle race between this and button press
 void enterSleep(uint64_t sleep_time_ms) {
   ESP_LOGI("APP", "Going to sleep");
@@ -274,7 +667,11 @@ void enterSleep(uint64_t sleep_time_ms) {
   dotstar.setPower(false);
 
   bt_stop();
+  config_flush();
   ntm_disconnect();
+  // Sleeping ends the first pass early, and a deep sleep wake goes through
+  // the bootloader, which would otherwise roll an unconfirmed update back
+  ota_confirm_boot();
 
   ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(BUTTON_GPIO, 0));
   ESP_ERROR_CHECK(rtc_gpio_pullup_en(BUTTON_GPIO));
@@ -283,37 +680,78 @@ void enterSleep(uint64_t sleep_time_ms) {
                                                ESP_EXT1_WAKEUP_ANY_HIGH));
   ESP_ERROR_CHECK(esp_sleep_enable_timer_wakeup(sleep_time_ms * 1000));
 
-  // TODO: Just using light sleep for now because for some reason
-  // deep sleep isn't waking up.
-  // if (lightOn) {
-  // Only light sleep appears to support running ledc
+  // Only light sleep supports running ledc, so deep sleep only while the
+  // light is off. A timer wake from deep sleep resumes from the RTC snapshot.
+  if (!light_is_on() && !light_is_fading() && saveSnapshot()) {
+    ESP_LOGI("APP", "Entering deep sleep");
+    light_hold_off();
+    esp_deep_sleep_start();
+  }
+
   // For some reason we need to explicitly tell the ESP32 to keep the 8mhz clock
   // on for ledc.
   ESP_ERROR_CHECK(esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_ON));
+  uint64_t sleep_start = millis64();
   ESP_ERROR_CHECK(esp_light_sleep_start());
-  // } else {
-  //   esp_deep_sleep_start();
-  // }
+  record_sleep_millis(millis64() - sleep_start);
 }
 
 uint64_t getNextSleepTime() {
   struct tm timeinfo;
 
-  if (button.isActive() || light_is_fading() || bt_is_enabled()) {
+  // Sleeping would stop the Bluetooth controller, which instead saves power
+  // with modem sleep and by scaling the CPU down between radio events
+  if (button.isActive() || bt_is_enabled()) {
     return 0;
   }
+  // Sleeping would freeze a job part way through, e.g. an HTTP request. The
+  // worker posts EVENT_WORKER when it's done.
+  if (worker_is_busy() || radio_window_open()) {
+    return 0;
+  }
+  uint64_t now = millis64();
+  uint64_t wake = radio_next_update_millis();
   if (ntm_get_local_time(&timeinfo)) {
-    return nextLightUpdateMillis - millis64();
+    // Hardware fades keep running while we sleep, only wake for the steps
+    // light_poll drives.
+    wake = std::min({wake, nextLightUpdateMillis, light_next_update_millis()});
+  } else if (wake == UINT64_MAX) {
+    // Without the time there's nothing to wake for, so stay up to be set
+    // over Bluetooth.
+    return 0;
   }
-  // If we haven't gotten the time for the first time, don't sleep unless we end
-  // up in an error state. This effectively implements retries on the network
-  // logic since it restarts on wake.
-  if (ntm_has_error()) {
-    return ERROR_SLEEP_DURATION_S * 1000;
+  // Otherwise sleep until the radio scheduler's next attempt
+  return wake > now ? wake - now : 0;
+}
+
+// When the light next changes, relative to millis64(). Transitions are planned
+// as UTC instants so the sleep is exact across a DST change, falling back on
+// `wallClockSecs` from LightManager::update if the zone can't be parsed.
+uint64_t plannedUpdateMillis(uint32_t wallClockSecs) {
+  char posixTz[NTM_POSIX_TZ_SIZE];
+  PosixTz tz;
+  timeval now;
+  gettimeofday(&now, NULL);
+
+  if (ntm_get_posix_tz(posixTz) && tz.parse(posixTz)) {
+    time_t next = lightManager.nextTransition(now.tv_sec, tz);
+    if (next != 0) {
+      return millis64() + (uint64_t)(next - now.tv_sec) * 1000 - now.tv_usec / 1000;
+    }
   }
-  return 0;
+  return millis64() + (uint64_t)wallClockSecs * 1000;
+}
+
+// `updateMillis`, relative to millis64(), in wall clock time. Rounded up so a
+// wake planned from it is never early.
+time_t transitionTime(uint64_t updateMillis) {
+  uint64_t now = millis64();
+  return time(NULL) + (updateMillis > now ? (updateMillis - now + 999) / 1000 : 0);
 }
 
+// When the light next changes, in wall clock time
+time_t nextTransitionTime() { return transitionTime(nextLightUpdateMillis); }
+
 void register_bt_handlers() {
   bt_register(bt_chr{.name = "wifi ssid",
                      .buffer = wifi_ssid,
@@ -329,12 +767,13 @@ void register_bt_handlers() {
                      .readable = false,
                      .writable = true,
                      .access_cb = wifiPswdAccessCb});
-  bt_register(bt_chr{.name = "current light",
-                     .buffer = color_access_buf,
-                     .bufferSize = sizeof(color_access_buf),
-                     .readable = true,
-                     .writable = true,
-                     .access_cb = colorAccessCb});
+  currentLightChr = bt_register(bt_chr{.name = "current light",
+                                       .buffer = color_access_buf,
+                                       .bufferSize = sizeof(color_access_buf),
+                                       .readable = true,
+                                       .writable = true,
+                                       .notifiable = true,
+                                       .access_cb = colorAccessCb});
   bt_register(bt_chr{.name = "wake time",
                      .buffer = time_access_buf,
                      .bufferSize = sizeof(time_access_buf),
@@ -359,6 +798,104 @@ void register_bt_handlers() {
                      .readable = true,
                      .writable = true,
                      .access_cb = currentTimeAccessCb});
+  bt_register(bt_chr{.name = "profile",
+                     .buffer = profile_access_buf,
+                     .bufferSize = sizeof(profile_access_buf) -
+                                   1, // Ensure space for null termination
+                     .readable = true,
+                     .writable = true,
+                     .access_cb = profileAccessCb});
+  bt_register(bt_chr{.name = "schedule",
+                     .buffer = schedule_access_buf,
+                     .bufferSize = sizeof(schedule_access_buf),
+                     .readable = true,
+                     .writable = true,
+                     .access_cb = scheduleAccessCb});
+  lightStateChr = bt_register(bt_chr{.name = "light state",
+                                     .buffer = light_state_buf,
+                                     .bufferSize = sizeof(light_state_buf),
+                                     .readable = true,
+                                     .writable = false,
+                                     .notifiable = true,
+                                     .access_cb = lightStateAccessCb});
+  ota_register();
+}
+
+// Tells subscribers when the light's color or next transition changes, and
+// how a fade is going. bt_poll coalesces everything asked for within
+// BT_NOTIFY_INTERVAL_MS, so a fade sends one update per interval.
+void publishLightState() {
+  uint8_t color[3];
+  light_get_color(color);
+  if (!std::equal(color, std::end(color), publishedColor)) {
+    std::copy(color, std::end(color), publishedColor);
+    bt_notify(currentLightChr);
+    bt_notify(lightStateChr);
+  }
+  if (nextLightUpdateMillis != publishedUpdateMillis) {
+    portENTER_CRITICAL(&publishedLock);
+    publishedUpdateMillis = nextLightUpdateMillis;
+    portEXIT_CRITICAL(&publishedLock);
+    bt_notify(lightStateChr);
+  }
+
+  bool fading = light_is_fading();
+  if (fading != publishedFading) {
+    publishedFading = fading;
+    bt_notify(lightStateChr);
+  }
+
+  bt_poll();
+  // Ask again straight after sending so progress goes out every interval
+  // until the fade is done
+  if (fading) {
+    bt_notify(lightStateChr);
+  }
+}
+
+// Passes credentials written over Bluetooth to the radio once they've settled,
+// or straight away if `now`. The radio only reconnects if they changed, and
+// does so without taking Bluetooth down.
+void applyWifiCredentials(bool now) {
+  if (btWroteWifiCredentials) {
+    btWroteWifiCredentials = false;
+    applyWifiCredentialsMillis = millis64() + WIFI_CREDENTIALS_SETTLE_MS;
+  }
+  if (applyWifiCredentialsMillis == 0 || (!now && millis64() < applyWifiCredentialsMillis)) {
+    return;
+  }
+  applyWifiCredentialsMillis = 0;
+  radio_set_credentials(wifi_ssid, wifi_pswd);
+}
+
+void reportWakeups() {
+  uint64_t now = millis64();
+  if (now < nextWakeupReportMillis) {
+    return;
+  }
+
+  uint32_t count = events_wakeup_count();
+  ESP_LOGI("APP", "Main task wakeups: %0.2f/s",
+           (float)(count - lastWakeupCount) / WAKEUP_REPORT_INTERVAL_SECS);
+  lastWakeupCount = count;
+  nextWakeupReportMillis = now + WAKEUP_REPORT_INTERVAL_SECS * 1000;
+}
+
+// The earliest time that something loop() checks can change without an event
+// being posted. Deadlines at or before `since` have already been handled.
+uint64_t nextDeadlineMillis(uint64_t since) {
+  uint64_t deadline = since + MAX_WAIT_MS;
+  uint64_t candidates[]{nextLightUpdateMillis, nextWakeupReportMillis,
+                        button.nextUpdateMillis(), power.nextUpdateMillis(),
+                        light_next_update_millis(), dotstar.nextUpdateMillis(),
+                        config_next_flush_millis(), radio_next_update_millis(),
+                        bt_next_update_millis(), applyWifiCredentialsMillis};
+  for (uint64_t candidate : candidates) {
+    if (candidate > since && candidate < deadline) {
+      deadline = candidate;
+    }
+  }
+  return deadline;
 }
 
 void loop() {
@@ -366,23 +903,24 @@ void loop() {
   LightManager::Next update;
 
   power.printState();
+  reportWakeups();
+  applyScheduleEdits();
+  light_poll();
+  config_poll();
 
-  if (nextLightUpdateMillis < millis64() || ntm_poll_clock_updated()) {
+  if (nextLightUpdateMillis <= millis64() || ntm_poll_clock_updated()) {
     if (ntm_get_local_time(&timeinfo)) {
       update = lightManager.update(timeinfo);
-      ESP_LOGI("APP", "%02d:%02d R%03d|G%03d|B%03d next: %lu\r\n",
-               timeinfo.tm_hour, timeinfo.tm_min, (*update.color)[0],
-               (*update.color)[1], (*update.color)[2], update.nextUpdateSecs);
+      nextLightUpdateMillis = plannedUpdateMillis(update.nextUpdateSecs);
+      ESP_LOGI("APP", "%02d:%02d R%03d|G%03d|B%03d next: %llums\r\n",
+               timeinfo.tm_hour, timeinfo.tm_min, update.color[0],
+               update.color[1], update.color[2], nextLightUpdateMillis - millis64());
 
       if (!std::equal(lastUpdateColor, std::end(lastUpdateColor),
-                      *update.color)) {
-        for (size_t i = 0; i < 3; i++) {
-          lastUpdateColor[i] = (*update.color)[i];
-        }
-        light_set_color(*update.color, ACTION_FADE_MS_PER_STEP);
+                      update.color.begin())) {
+        std::copy(update.color.begin(), update.color.end(), lastUpdateColor);
+        light_set_color(update.color.data(), ACTION_FADE_MS_PER_STEP);
       }
-
-      nextLightUpdateMillis = millis64() + update.nextUpdateSecs * 1000;
     } else {
       ESP_LOGI("APP", "Awaiting time...");
       nextLightUpdateMillis =
@@ -391,16 +929,20 @@ void loop() {
   }
 
   Button::CallbackReason buttonReason = button.poll();
+  if (buttonReason != Button::CallbackReason::NONE) {
+    initialize();
+  }
   switch (buttonReason) {
   case Button::CallbackReason::PRESS_RELEASE:
     ESP_LOGI("APP", "Button: PRESS_RELEASE");
     if (bt_is_enabled()) {
       bt_stop();
-      // TODO: There's probably a gentler way to reset this, plus we could only
-      // reset if something changes.
-      ntm_disconnect();
-      ntm_connect(wifi_ssid, wifi_pswd);
+      // Don't wait out the settle time for credentials written just before
+      applyWifiCredentials(true);
       nextLightUpdateMillis = 0; // Force an update in case things have changed
+      // The update check already ran this pass and nextDeadlineMillis skips
+      // deadlines from before it, so wake straight back up for it.
+      events_post(EVENT_LIGHT);
       if (!btWroteColor) {
         light_set_color(lastUpdateColor, 0);
       }
@@ -412,22 +954,25 @@ void loop() {
     ESP_LOGI("APP", "Button: HOLD_START");
     if (bt_is_enabled()) {
       // If we hold again after Bluetooth is enabled, restart.
+      config_flush();
       esp_restart();
     } else {
       // Set the color to blue to indicate the state but don't actually enable
       // Bluetooth until releasing the button since continuing to hold will
       // trigger a restart instead.
-      light_set_color(LIGHT_COLOR_BLUE, 0);
+      light_set_color(LIGHT_COLOR_BLUE.data(), 0);
     }
 
     break;
   case Button::CallbackReason::HOLD_REPEAT:
     // If we hold for double the bluetooth-enabled cycle, restart
     ESP_LOGI("APP", "Button: HOLD_REPEAT");
+    config_flush();
     esp_restart();
     break;
   case Button::CallbackReason::HOLD_RELEASE:
     btWroteColor = false;
+    copyScheduleForEdits();
     bt_start();
     ESP_LOGI("APP", "Button: HOLD_RELEASE");
     break;
@@ -435,21 +980,32 @@ void loop() {
     break;
   }
 
+  applyWifiCredentials(false);
+  if (radio_window_due(nextTransitionTime())) {
+    initialize();
+    radio_open_window(wifi_ssid, wifi_pswd);
+  }
+  radio_poll();
+  publishLightState();
+
+  if (ota_restart_due()) {
+    ESP_LOGI("APP", "Restarting into the update");
+    config_flush();
+    esp_restart();
+  }
+
   if (power.isPowered()) {
-    // If WiFi is disabled (e.g. after sleep), re-enable it so we can fetch time
-    if (!ntm_is_active()) {
-      ntm_connect(wifi_ssid, wifi_pswd);
-    }
+    initialize();
 
     uint8_t color[3]{0, 0, 0};
     if (ntm_has_error()) {
       // Purple
       color[0] = 15;
       color[2] = 10;
-    } else if (ntm_is_connected()) {
-      color[1] = 10; // green
-    } else {
+    } else if (radio_window_open() && !ntm_is_connected()) {
       color[2] = 10; // blue
+    } else {
+      color[1] = 10; // green
     }
     dotstar.setColor(color);
   } else {
@@ -468,22 +1024,17 @@ extern "C" void app_main() {
 
   uart_set_baudrate(UART_NUM_0, 115200);
 
-  esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
+  events_init();
+  config_init();
 
-  // Initialize NVS
-  esp_err_t ret = nvs_flash_init();
-  if (ret == ESP_ERR_NVS_NO_FREE_PAGES ||
-      ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-    ESP_ERROR_CHECK(nvs_flash_erase());
-    ret = nvs_flash_init();
-  }
-  ESP_ERROR_CHECK(ret);
+  esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
 
   // NB: I don't know if this is necessary/does anything
   rtc_clk_slow_freq_set(RTC_SLOW_FREQ_8MD256);
 
   ESP_LOGI("APP", "wakeup reason: %d\n", wakeup_reason);
 
+  ESP_ERROR_CHECK(gpio_install_isr_service(0));
   power.setup();
 
   if (wakeup_reason != ESP_SLEEP_WAKEUP_UNDEFINED) {
@@ -494,18 +1045,16 @@ extern "C" void app_main() {
   // press debounce routine.
   button.setup(wakeup_reason == ESP_SLEEP_WAKEUP_EXT0);
 
-  ESP_LOGI("APP", "Loading config");
-  config_load(actions, wifi_ssid, wifi_pswd);
-  ESP_LOGI("APP", "Loaded SSID: %s Pass: %s Wake time: %02d:%02d", wifi_ssid,
-           wifi_pswd, actions[WAKE_IDX].time.hour,
-           actions[WAKE_IDX].time.minute);
+  if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER && restoreSnapshot()) {
+    ESP_LOGI("APP", "Resumed %s from deep sleep snapshot",
+             profiles[0].name);
+  } else {
+    initialize();
+  }
 
   ESP_LOGI("APP", "Configuring LEDs");
   light_setup();
 
-  ESP_LOGI("APP", "Initializing network time manager");
-  ntm_init();
-
   ESP_LOGI("APP", "Configuring bluetooth handlers");
   register_bt_handlers();
 
@@ -514,9 +1063,12 @@ extern "C" void app_main() {
 
   while (1) {
     esp_task_wdt_reset();
+    uint64_t loopStartMillis = millis64();
     loop();
-    // TODO: Consider switching tick rate back to 100hz and doing less with a
-    // loop
-    vTaskDelay(pdMS_TO_TICKS(1));
+    // A full pass ran without crashing, so an update is good to keep
+    ota_confirm_boot();
+    // Block until an ISR, timer or another task posts an event or until the
+    // next deadline that loop() polls for.
+    events_wait(nextDeadlineMillis(loopStartMillis));
   }
 }
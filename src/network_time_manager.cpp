@@ -1,19 +1,31 @@
 #include "network_time_manager.h"
 
+#include <cstddef>
 #include <cstring>
 
+#include "esp_attr.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_private/esp_clk.h"
+#include "esp_rom_crc.h"
 #include "esp_sntp.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "freertos/task.h"
+#include "nvs.h"
 #include "time.h"
 
+#include "ClockDrift.h"
+#include "PosixTz.h"
+#include "TzResponse.h"
+#include "events.h"
+#include "worker.h"
 #include "zones.h"
 
-#define MAX_HTTP_OUTPUT_BUFFER 128
 #define MAX_RETRIES 5
 #define WIFI_ACTIVE_BIT BIT0
 #define WIFI_CONNECTED_BIT BIT1
@@ -23,22 +35,125 @@
 #define CLOCK_UPDATED_BIT BIT5
 #define JAN_1_2020_EPOCH 1577836800
 
+#define NVS_NAMESPACE "ntm"
+#define NVS_WIFI_CACHE_KEY "wifi"
+#define NVS_TZ_CACHE_KEY "tz"
+#define NVS_CLOCK_KEY "clock"
+#define CLOCK_RECORD_MAGIC 0x636c6f6b // "clok"
+#define SECS_PER_DAY (24 * 60 * 60)
+#define TZ_ZONE_SIZE TZ_RESPONSE_VALUE_SIZE
+// Beacons to sleep through in modem power save
+#define NTM_LISTEN_INTERVAL 3
+
 const static char *TAG = "ntm";
 
 static wifi_config_t s_wifi_config = {
     .sta =
         {
+            .listen_interval = NTM_LISTEN_INTERVAL,
             .pmf_cfg = {.capable = true, .required = false},
         },
 };
 
+// Where we last connected, so the next connect can go straight to the AP
+// without a scan. Kept in RTC memory across deep sleep and in NVS across power
+// loss. The IP isn't cached here: with CONFIG_LWIP_DHCP_RESTORE_LAST_IP the
+// DHCP client asks for its last address straight away, which saves most of
+// the DHCP exchange while the server still renews the lease.
+struct WifiCache {
+  uint8_t ssid[32];
+  uint8_t bssid[6];
+  uint8_t channel;
+};
+RTC_DATA_ATTR static WifiCache s_rtc_wifi_cache;
+RTC_DATA_ATTR static bool s_rtc_wifi_cache_valid;
+// The copy the worker writes to NVS, see s_clock_to_save
+static WifiCache s_wifi_cache_to_save;
+static bool s_wifi_cache_save_queued;
+static portMUX_TYPE s_wifi_cache_save_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// The last timezone looked up, so it doesn't need fetching on every connect
+struct TzCache {
+  char zone[TZ_ZONE_SIZE];
+  char posix_tz[NTM_POSIX_TZ_SIZE];
+  // 0 if the clock wasn't set when it was fetched
+  time_t fetched_at;
+  // The AP we were connected through, a change suggests we have moved
+  uint8_t bssid[6];
+};
+static TzCache s_tz_cache;
+static bool s_tz_cache_valid;
+static volatile bool s_tz_fetching;
+
+// How fast the clock drifts between syncs, and when it was last synced (0 if
+// it hasn't been since it was last set by hand or lost power).
+RTC_DATA_ATTR static ClockDrift s_rtc_drift;
+RTC_DATA_ATTR static time_t s_rtc_last_sync;
+// Only written from the SNTP callback, a 32-bit read elsewhere is atomic
+static uint32_t s_sync_count;
+
+// The last time the clock was known, against the RTC timer, which keeps
+// counting through every reset but a power on. Lets the clock, and so the
+// schedule, pick up straight after a restart instead of waiting for WiFi.
+struct ClockRecord {
+  uint32_t magic;
+  int64_t epoch_us;
+  // esp_clk_rtc_time() at epoch_us
+  uint64_t rtc_us;
+  // How far off epoch_us could have been, UINT32_MAX if only the time of day
+  // was known
+  uint32_t error_ms;
+  ClockDrift drift;
+  time_t last_sync;
+  char posix_tz[NTM_POSIX_TZ_SIZE];
+  uint32_t crc;
+};
+RTC_NOINIT_ATTR static ClockRecord s_rtc_clock;
+// When s_rtc_clock was last queued to be copied to NVS
+static time_t s_clock_saved_at;
+// The copy the worker writes to NVS. The clock is recorded from the Bluetooth
+// host and lwIP tasks, which shouldn't wait on a flash commit.
+static ClockRecord s_clock_to_save;
+static bool s_clock_save_queued;
+static portMUX_TYPE s_clock_save_lock = portMUX_INITIALIZER_UNLOCKED;
+// The last time known from NVS even if the clock couldn't be restored from
+// it, so setting the time by hand at least keeps a recent date
+static time_t s_last_known_time;
+
+static uint32_t ntm_clock_record_crc(const ClockRecord &record) {
+  return esp_rom_crc32_le(0, (const uint8_t *)&record, offsetof(ClockRecord, crc));
+}
+
+static bool ntm_clock_record_intact(const ClockRecord &record) {
+  return record.magic == CLOCK_RECORD_MAGIC && record.crc == ntm_clock_record_crc(record);
+}
+
+static esp_netif_t *s_sta_netif;
+static bool s_using_cache;
+static int64_t s_connect_start_us;
+static bool s_awaiting_first_sync;
+
 static int s_retry_num = 0;
-static size_t s_http_output_len;
-static char s_response_buffer[MAX_HTTP_OUTPUT_BUFFER]{};
+static char s_posix_tz[NTM_POSIX_TZ_SIZE];
+// Only touched by the fetch job, which runs one at a time
+static TzResponseParser s_tz_parser;
 
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_ntm_event_group;
-static TaskHandle_t s_tz_fetch_task_handle;
+
+static void ntm_save_wifi_cache();
+static void ntm_configure_sta(bool use_cache);
+static void ntm_maybe_refresh_tz();
+static void ntm_tz_fetch_job(void *arg);
+static void ntm_record_clock(uint32_t error_ms);
+
+static uint32_t ntm_sync_interval_s() {
+  uint32_t interval = clock_drift_next_interval_s(s_rtc_drift, NTM_MAX_CLOCK_ERROR_MS,
+                                                  NTM_SYNC_MIN_INTERVAL_S, NTM_SYNC_MAX_INTERVAL_S);
+  ESP_LOGD(TAG, "next sync in %lus, predicted error %lums", interval,
+           clock_drift_predicted_error_ms(s_rtc_drift, interval));
+  return interval;
+}
 
 void sntp_sync_time(struct timeval *tv) {
   struct timeval old;
@@ -49,10 +164,34 @@ void sntp_sync_time(struct timeval *tv) {
 
   if (old.tv_sec < 16e8) { // Before ~2020
     ESP_LOGI(TAG, "time initialized");
+    s_rtc_last_sync = 0;
   } else {
-    ESP_LOGI(TAG, "time updated, offset: %lld", (long)old.tv_sec - tv->tv_sec);
+    int64_t offset_ms =
+        (int64_t)(old.tv_sec - tv->tv_sec) * 1000 + (old.tv_usec - tv->tv_usec) / 1000;
+    ESP_LOGI(TAG, "time updated, offset: %lldms", offset_ms);
+    if (s_rtc_last_sync != 0 && tv->tv_sec > s_rtc_last_sync &&
+        clock_drift_add_sample(s_rtc_drift, offset_ms, tv->tv_sec - s_rtc_last_sync)) {
+      ESP_LOGI(TAG, "drift %ldppb +/- %luppb", s_rtc_drift.rate_ppb, s_rtc_drift.deviation_ppb);
+    }
+  }
+  s_rtc_last_sync = tv->tv_sec;
+  ntm_record_clock(CLOCK_DRIFT_SYNC_ERROR_MS);
+  // Only takes effect from the poll after this one, which lwIP schedules once
+  // this returns.
+  sntp_set_sync_interval(ntm_sync_interval_s() * 1000);
+  if (s_awaiting_first_sync) {
+    s_awaiting_first_sync = false;
+    ESP_LOGI(TAG, "connect to first sync: %lldms",
+             (esp_timer_get_time() - s_connect_start_us) / 1000);
+    if (s_rtc_wifi_cache_valid) {
+      ntm_save_wifi_cache();
+    }
+    // Now that the clock is known to be right, check the cache's age
+    ntm_maybe_refresh_tz();
   }
+  s_sync_count++;
   xEventGroupSetBits(s_ntm_event_group, CLOCK_UPDATED_BIT);
+  events_post(EVENT_NETWORK);
 }
 
 esp_err_t ntm_http_event_handler(esp_http_client_event_t *evt) {
@@ -68,23 +207,17 @@ esp_err_t ntm_http_event_handler(esp_http_client_event_t *evt) {
     break;
   case HTTP_EVENT_REDIRECT:
     ESP_LOGD(TAG, "HTTP_EVENT_REDIRECT");
+    // Only the final response's body counts
+    ((TzResponseParser *)evt->user_data)->reset();
     break;
   case HTTP_EVENT_ON_HEADER:
     ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
     break;
-  case HTTP_EVENT_ON_DATA: {
+  case HTTP_EVENT_ON_DATA:
     ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
-    size_t n = MAX_HTTP_OUTPUT_BUFFER - s_http_output_len - 1; // -1 to ensure terminating null byte
-    if (evt->data_len > n) {
-      ESP_LOGE(TAG, "HTTP data size exceeded receive buffer");
-    } else {
-      n = evt->data_len;
-    }
-
-    memcpy(evt->user_data + s_http_output_len, evt->data, evt->data_len);
-    s_http_output_len += evt->data_len;
+    // Parsed straight out of the client's buffer, whatever the body's size
+    ((TzResponseParser *)evt->user_data)->feed((const char *)evt->data, evt->data_len);
     break;
-  }
   case HTTP_EVENT_ON_FINISH:
     ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
     break;
@@ -96,76 +229,278 @@ esp_err_t ntm_http_event_handler(esp_http_client_event_t *evt) {
 }
 
 void ntm_set_posix_tz(const char *posix_str) {
+  strlcpy(s_posix_tz, posix_str, sizeof(s_posix_tz));
   setenv("TZ", posix_str, 1);
   tzset();
+  if (ntm_clock_record_intact(s_rtc_clock)) {
+    strlcpy(s_rtc_clock.posix_tz, posix_str, sizeof(s_rtc_clock.posix_tz));
+    s_rtc_clock.crc = ntm_clock_record_crc(s_rtc_clock);
+  }
 
   xEventGroupSetBits(s_ntm_event_group, TZ_READY_BIT);
   xEventGroupSetBits(s_ntm_event_group, CLOCK_UPDATED_BIT);
   xEventGroupClearBits(s_ntm_event_group, TZ_FAIL_BIT);
+  events_post(EVENT_NETWORK);
 }
 
-void ntm_tz_fetch_task(void *pvParameters) {
-  while (1) {
-    xTaskNotifyWaitIndexed(0, 0, ULONG_MAX, NULL, portMAX_DELAY);
-    s_http_output_len = 0;
-    /**
-     * NOTE: All the configuration parameters for http_client must be spefied either in URL or as host and path parameters.
-     * If host and path parameters are not set, query parameter will be ignored. In such cases,
-     * query parameter should be specified in URL.
-     *
-     * If URL as well as host and path parameters are specified, values of host and path will be considered.
-     */
-    esp_http_client_config_t config = {
-        .host = "ip-api.com",
-        .path = "/csv",
-        .query = "fields=status,message,timezone",
-        .event_handler = ntm_http_event_handler,
-        .user_data = s_response_buffer, // Pass address of local buffer to get response
-    };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-
-    esp_err_t err = esp_http_client_perform(client);
+static bool clock_is_set() { return time(NULL) > JAN_1_2020_EPOCH; }
+
+// Whether `record` is intact and its RTC timer reading can still be trusted.
+// A power on or brownout reset restarts the RTC timer.
+static bool ntm_clock_record_valid(const ClockRecord &record) {
+  esp_reset_reason_t reason = esp_reset_reason();
+  return ntm_clock_record_intact(record) && reason != ESP_RST_POWERON &&
+         reason != ESP_RST_BROWNOUT && esp_clk_rtc_time() >= record.rtc_us;
+}
+
+static void ntm_save_clock_job(void *arg) {
+  ClockRecord record;
+  portENTER_CRITICAL(&s_clock_save_lock);
+  record = s_clock_to_save;
+  s_clock_save_queued = false;
+  portEXIT_CRITICAL(&s_clock_save_lock);
+
+  // The copy in RTC memory still covers most restarts, so a failure here is
+  // worth a log rather than a panic
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err == ESP_OK) {
+    err = nvs_set_blob(handle, NVS_CLOCK_KEY, &record, sizeof(record));
     if (err == ESP_OK) {
-      ESP_LOGI(TAG, "HTTP GET Status = %d, content_length = %lld",
-               esp_http_client_get_status_code(client), esp_http_client_get_content_length(client));
-    } else {
-      ESP_LOGW(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
+      err = nvs_commit(handle);
     }
+    nvs_close(handle);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Unable to save the clock: %s", esp_err_to_name(err));
+  }
+}
 
-    esp_http_client_cleanup(client);
+// Records the clock as right to within `error_ms` as of now, in RTC memory and
+// every NTM_CLOCK_SAVE_INTERVAL_S in NVS.
+static void ntm_record_clock(uint32_t error_ms) {
+  timeval now;
+  gettimeofday(&now, NULL);
+
+  s_rtc_clock.magic = CLOCK_RECORD_MAGIC;
+  s_rtc_clock.epoch_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+  s_rtc_clock.rtc_us = esp_clk_rtc_time();
+  s_rtc_clock.error_ms = error_ms;
+  s_rtc_clock.drift = s_rtc_drift;
+  s_rtc_clock.last_sync = s_rtc_last_sync;
+  strlcpy(s_rtc_clock.posix_tz, s_posix_tz, sizeof(s_rtc_clock.posix_tz));
+  s_rtc_clock.crc = ntm_clock_record_crc(s_rtc_clock);
+
+  if (s_clock_saved_at != 0 && now.tv_sec - s_clock_saved_at < NTM_CLOCK_SAVE_INTERVAL_S) {
+    return;
+  }
+  portENTER_CRITICAL(&s_clock_save_lock);
+  s_clock_to_save = s_rtc_clock;
+  bool queue = !s_clock_save_queued;
+  s_clock_save_queued = true;
+  portEXIT_CRITICAL(&s_clock_save_lock);
+  if (queue && !worker_submit(ntm_save_clock_job, NULL)) {
+    // Try again on the next record
+    portENTER_CRITICAL(&s_clock_save_lock);
+    s_clock_save_queued = false;
+    portEXIT_CRITICAL(&s_clock_save_lock);
+    return;
+  }
+  s_clock_saved_at = now.tv_sec;
+}
 
-    s_response_buffer[s_http_output_len] = 0; // Null-terminate string
+// Sets the clock from `record` if nothing has since boot, and picks the drift
+// estimate back up. Returns false if `record` can't be trusted.
+static bool ntm_restore_clock(const ClockRecord &record, const char *source) {
+  if (!ntm_clock_record_valid(record)) {
+    return false;
+  }
+  if (&record != &s_rtc_clock) {
+    s_rtc_clock = record;
+  }
 
-    if (strncmp("success,", s_response_buffer, 8) == 0) {
-      const char *response_tz = (char *)s_response_buffer + 8; // Advance past 'success,'
-      // Replace newline with terminating null byte
-      *strchr(response_tz, '\n') = 0;
-      const char *posix_str = micro_tz_db_get_posix_str(response_tz);
+  // Both are zeroed by any reset other than a deep sleep wake
+  if (s_rtc_drift.samples == 0) {
+    s_rtc_drift = record.drift;
+  }
+  if (s_rtc_last_sync == 0) {
+    s_rtc_last_sync = record.last_sync;
+  }
+  if (clock_is_set()) {
+    return true;
+  }
 
-      if (posix_str == NULL) {
-        ESP_LOGE(TAG, "Unable to find POSIX string for zone %s", response_tz);
-        xEventGroupSetBits(s_ntm_event_group, TZ_FAIL_BIT);
-      } else {
-        ESP_LOGI(TAG, "Setting TZ=%s for zone %s", posix_str, response_tz);
-        ntm_set_posix_tz(posix_str);
-      }
-    } else {
-      ESP_LOGE(TAG, "Error fetching timezone from IP: %s", s_response_buffer);
-      xEventGroupSetBits(s_ntm_event_group, TZ_FAIL_BIT);
+  int64_t us = record.epoch_us + (int64_t)(esp_clk_rtc_time() - record.rtc_us);
+  const timeval tv =
+      timeval{.tv_sec = (time_t)(us / 1000000), .tv_usec = (suseconds_t)(us % 1000000)};
+  settimeofday(&tv, NULL);
+  ESP_LOGI(TAG, "clock restored from %s, error up to %lums", source, ntm_clock_error_ms());
+
+  xEventGroupSetBits(s_ntm_event_group, CLOCK_UPDATED_BIT);
+  events_post(EVENT_NETWORK);
+  return true;
+}
+
+static void ntm_load_clock() {
+  nvs_handle_t handle;
+  if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    return;
+  }
+  ClockRecord stored;
+  size_t length = sizeof(stored);
+  if (nvs_get_blob(handle, NVS_CLOCK_KEY, &stored, &length) == ESP_OK &&
+      length == sizeof(stored) && ntm_clock_record_intact(stored)) {
+    s_last_known_time = stored.epoch_us / 1000000;
+    ntm_restore_clock(stored, "NVS");
+  }
+  nvs_close(handle);
+}
+
+static void ntm_load_tz_cache() {
+  nvs_handle_t handle;
+  if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    return;
+  }
+  size_t length = sizeof(s_tz_cache);
+  s_tz_cache_valid = nvs_get_blob(handle, NVS_TZ_CACHE_KEY, &s_tz_cache, &length) == ESP_OK &&
+                     length == sizeof(s_tz_cache);
+  nvs_close(handle);
+}
+
+static void ntm_save_tz_cache(const char *zone, const char *posix_tz) {
+  strlcpy(s_tz_cache.zone, zone, sizeof(s_tz_cache.zone));
+  strlcpy(s_tz_cache.posix_tz, posix_tz, sizeof(s_tz_cache.posix_tz));
+  s_tz_cache.fetched_at = clock_is_set() ? time(NULL) : 0;
+  memcpy(s_tz_cache.bssid, s_rtc_wifi_cache.bssid, sizeof(s_tz_cache.bssid));
+  s_tz_cache_valid = true;
+
+  // The zone can always be fetched again, so keep the copy in RAM and only log
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err == ESP_OK) {
+    err = nvs_set_blob(handle, NVS_TZ_CACHE_KEY, &s_tz_cache, sizeof(s_tz_cache));
+    if (err == ESP_OK) {
+      err = nvs_commit(handle);
     }
+    nvs_close(handle);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Unable to save the timezone cache: %s", esp_err_to_name(err));
+  }
+}
+
+static void ntm_tz_fetch_failed() {
+  // A failed refresh isn't an error while the cached timezone still applies
+  if (!(xEventGroupGetBits(s_ntm_event_group) & TZ_READY_BIT)) {
+    xEventGroupSetBits(s_ntm_event_group, TZ_FAIL_BIT);
   }
+  events_post(EVENT_NETWORK);
+}
 
-  vTaskDelete(NULL);
+// Looks the timezone up again if there is no cached one, we've connected
+// through a different AP, or the cached one is older than
+// NTM_TZ_REFRESH_INTERVAL_S.
+static void ntm_maybe_refresh_tz() {
+  const char *reason = NULL;
+  if (!s_tz_cache_valid) {
+    reason = "no cached zone";
+  } else if (memcmp(s_tz_cache.bssid, s_rtc_wifi_cache.bssid, sizeof(s_tz_cache.bssid)) != 0) {
+    reason = "network changed";
+  } else if (clock_is_set() &&
+             (s_tz_cache.fetched_at == 0 ||
+              time(NULL) - s_tz_cache.fetched_at > NTM_TZ_REFRESH_INTERVAL_S)) {
+    reason = "cached zone expired";
+  }
+
+  if (reason != NULL && !s_tz_fetching) {
+    ESP_LOGI(TAG, "Fetching timezone: %s", reason);
+    s_tz_fetching = true;
+    if (!worker_submit(&ntm_tz_fetch_job, NULL)) {
+      s_tz_fetching = false;
+      ntm_tz_fetch_failed();
+    }
+  }
+}
+
+static void ntm_tz_fetch_job(void *arg) {
+  s_tz_parser.reset();
+  esp_http_client_config_t config = {
+      .url = NTM_TZ_URL,
+      .event_handler = ntm_http_event_handler,
+      .user_data = &s_tz_parser,
+  };
+  esp_http_client_handle_t client = esp_http_client_init(&config);
+
+  esp_err_t err = esp_http_client_perform(client);
+  int status = -1;
+  if (err == ESP_OK) {
+    status = esp_http_client_get_status_code(client);
+    ESP_LOGI(TAG, "HTTP GET Status = %d, content_length = %lld", status,
+             esp_http_client_get_content_length(client));
+  } else {
+    ESP_LOGW(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
+  }
+
+  esp_http_client_cleanup(client);
+
+  TzResponseParser::Result result = s_tz_parser.finish();
+  const char *zone = s_tz_parser.value();
+  if (status == 200 && result == TzResponseParser::Result::SUCCESS) {
+    const char *posix_str = micro_tz_db_get_posix_str(zone);
+
+    if (posix_str == NULL) {
+      ESP_LOGE(TAG, "Unable to find POSIX string for zone %s", zone);
+      ntm_tz_fetch_failed();
+    } else {
+      ESP_LOGI(TAG, "Setting TZ=%s for zone %s", posix_str, zone);
+      ntm_set_posix_tz(posix_str);
+      ntm_save_tz_cache(zone, posix_str);
+    }
+  } else if (result == TzResponseParser::Result::FAILURE) {
+    ESP_LOGE(TAG, "Error fetching timezone from IP: %s", s_tz_parser.value());
+    ntm_tz_fetch_failed();
+  } else {
+    if (err == ESP_OK) {
+      ESP_LOGE(TAG, "Unexpected timezone response, status %d", status);
+    }
+    ntm_tz_fetch_failed();
+  }
+  s_tz_fetching = false;
+  // The events above went out while the fetch still counted as pending
+  events_post(EVENT_NETWORK);
 }
 
 void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
   if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
     esp_wifi_connect();
+  } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+    wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
+    if (!s_using_cache) {
+      memcpy(s_rtc_wifi_cache.ssid, s_wifi_config.sta.ssid, sizeof(s_rtc_wifi_cache.ssid));
+      memcpy(s_rtc_wifi_cache.bssid, event->bssid, sizeof(s_rtc_wifi_cache.bssid));
+      s_rtc_wifi_cache.channel = event->channel;
+    }
   } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
     xEventGroupClearBits(s_ntm_event_group, WIFI_CONNECTED_BIT);
 
     uint8_t reason = ((wifi_event_sta_disconnected_t *)event_data)->reason;
     ESP_LOGI(TAG, "reason: %d", reason);
+    if (reason == WIFI_REASON_ASSOC_LEAVE) {
+      // We left, either stopping or to reconnect with new credentials, so
+      // there's nothing to retry
+      events_post(EVENT_NETWORK);
+      return;
+    }
+    if (s_using_cache) {
+      // The AP may have moved channel or gone away, so don't count this as a
+      // retry and fall back to a full scan.
+      ESP_LOGI(TAG, "cached AP failed, scanning");
+      s_rtc_wifi_cache_valid = false;
+      ntm_configure_sta(false);
+      esp_wifi_connect();
+      events_post(EVENT_NETWORK);
+      return;
+    }
     // TODO: Arduino doesn't retry on AUTH_FAIL but sometime this seems necessary...
     // if (reason == WIFI_REASON_AUTH_FAIL) {
 
@@ -180,55 +515,183 @@ void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, voi
       ESP_LOGW(TAG, "failed to connect to the AP");
       xEventGroupSetBits(s_ntm_event_group, WIFI_FAIL_BIT);
     }
+    events_post(EVENT_NETWORK);
   } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
     xEventGroupSetBits(s_ntm_event_group, WIFI_CONNECTED_BIT);
     xEventGroupClearBits(s_ntm_event_group, WIFI_FAIL_BIT);
 
     ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-    ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+    ESP_LOGI(TAG, "got ip:" IPSTR " in %lldms (%s)", IP2STR(&event->ip_info.ip),
+             (esp_timer_get_time() - s_connect_start_us) / 1000,
+             s_using_cache ? "cached AP" : "scan");
     s_retry_num = 0;
 
-    xTaskNotify(s_tz_fetch_task_handle, 0, eNoAction);
+    s_rtc_wifi_cache_valid = true;
+    // Once connected, a later drop is an ordinary disconnect to retry as is
+    s_using_cache = false;
+    events_post(EVENT_NETWORK);
+
+    ntm_maybe_refresh_tz();
 
     // Restart sntp every time we reconnect to reset the polling timeout
     if (sntp_enabled()) {
       sntp_stop();
     }
+    sntp_set_sync_interval(ntm_sync_interval_s() * 1000);
     sntp_init();
   } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_LOST_IP) {
     xEventGroupClearBits(s_ntm_event_group, WIFI_CONNECTED_BIT);
     ESP_LOGW(TAG, "lost IP");
+    events_post(EVENT_NETWORK);
     // TODO: Do we try a reconnect here?
   }
 }
 
-void ntm_connect(const char *network_name, const char *network_pswd) {
-  memcpy(s_wifi_config.sta.ssid, network_name, sizeof(s_wifi_config.sta.ssid));
-  memcpy(s_wifi_config.sta.password, network_pswd, sizeof(s_wifi_config.sta.password));
+static void ntm_load_wifi_cache() {
+  nvs_handle_t handle;
+  if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    return;
+  }
+  size_t length = sizeof(s_rtc_wifi_cache);
+  s_rtc_wifi_cache_valid =
+      nvs_get_blob(handle, NVS_WIFI_CACHE_KEY, &s_rtc_wifi_cache, &length) == ESP_OK &&
+      length == sizeof(s_rtc_wifi_cache);
+  nvs_close(handle);
+}
 
-  xEventGroupSetBits(s_ntm_event_group, WIFI_ACTIVE_BIT);
+static void ntm_save_wifi_cache_job(void *arg) {
+  WifiCache cache;
+  portENTER_CRITICAL(&s_wifi_cache_save_lock);
+  cache = s_wifi_cache_to_save;
+  s_wifi_cache_save_queued = false;
+  portEXIT_CRITICAL(&s_wifi_cache_save_lock);
+
+  // Without the cache the next connect just scans, so a failure here is worth
+  // a log rather than a panic
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err == ESP_OK) {
+    // Only write if something changed, reconnecting to the same AP is the norm
+    WifiCache stored;
+    size_t length = sizeof(stored);
+    if (nvs_get_blob(handle, NVS_WIFI_CACHE_KEY, &stored, &length) != ESP_OK ||
+        length != sizeof(stored) || memcmp(&stored, &cache, sizeof(stored)) != 0) {
+      err = nvs_set_blob(handle, NVS_WIFI_CACHE_KEY, &cache, sizeof(cache));
+      if (err == ESP_OK) {
+        err = nvs_commit(handle);
+      }
+    }
+    nvs_close(handle);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Unable to save the WiFi cache: %s", esp_err_to_name(err));
+  }
+}
+
+// Queues s_rtc_wifi_cache to be copied to NVS on the worker, since this is
+// called from the lwIP task
+static void ntm_save_wifi_cache() {
+  portENTER_CRITICAL(&s_wifi_cache_save_lock);
+  s_wifi_cache_to_save = s_rtc_wifi_cache;
+  bool queue = !s_wifi_cache_save_queued;
+  s_wifi_cache_save_queued = true;
+  portEXIT_CRITICAL(&s_wifi_cache_save_lock);
+  if (queue && !worker_submit(ntm_save_wifi_cache_job, NULL)) {
+    // The RTC memory copy still covers deep sleep, the next sync tries again
+    portENTER_CRITICAL(&s_wifi_cache_save_lock);
+    s_wifi_cache_save_queued = false;
+    portEXIT_CRITICAL(&s_wifi_cache_save_lock);
+  }
+}
+
+// Points the station at the cached AP when `use_cache`, otherwise scans all
+// channels.
+static void ntm_configure_sta(bool use_cache) {
+  s_using_cache = use_cache;
+
+  s_wifi_config.sta.bssid_set = use_cache;
+  s_wifi_config.sta.channel = use_cache ? s_rtc_wifi_cache.channel : 0;
+  if (use_cache) {
+    memcpy(s_wifi_config.sta.bssid, s_rtc_wifi_cache.bssid, sizeof(s_wifi_config.sta.bssid));
+  }
+  s_wifi_config.sta.scan_method = use_cache ? WIFI_FAST_SCAN : WIFI_ALL_CHANNEL_SCAN;
+  ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config));
+}
 
+// Copies the credentials into the station config, returning whether they
+// differ from the ones there
+static bool ntm_set_credentials(const char *network_name, const char *network_pswd) {
+  wifi_sta_config_t &sta = s_wifi_config.sta;
+  bool changed = strncmp((const char *)sta.ssid, network_name, sizeof(sta.ssid)) != 0 ||
+                 strncmp((const char *)sta.password, network_pswd, sizeof(sta.password)) != 0;
+  memcpy(sta.ssid, network_name, sizeof(sta.ssid));
+  memcpy(sta.password, network_pswd, sizeof(sta.password));
   // Zero-length password
-  s_wifi_config.sta.threshold.authmode =
-      (network_pswd[0] == 0) ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+  sta.threshold.authmode = (network_pswd[0] == 0) ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+  return changed;
+}
+
+// Resets everything that tracks a connection attempt, so each one starts
+// fresh and the last one's failure doesn't stick
+static void ntm_start_attempt() {
+  xEventGroupClearBits(s_ntm_event_group, WIFI_FAIL_BIT | TZ_FAIL_BIT);
+  s_connect_start_us = esp_timer_get_time();
+  s_retry_num = 0;
+  s_awaiting_first_sync = true;
+}
+
+// Whether the cached AP is one on the configured network
+static bool ntm_cache_matches() {
+  if (!s_rtc_wifi_cache_valid) {
+    ntm_load_wifi_cache();
+  }
+  return s_rtc_wifi_cache_valid && memcmp(s_rtc_wifi_cache.ssid, s_wifi_config.sta.ssid,
+                                          sizeof(s_rtc_wifi_cache.ssid)) == 0;
+}
+
+void ntm_connect(const char *network_name, const char *network_pswd) {
+  ntm_set_credentials(network_name, network_pswd);
+  ntm_start_attempt();
+  xEventGroupSetBits(s_ntm_event_group, WIFI_ACTIVE_BIT);
+  bool use_cache = ntm_cache_matches();
 
   ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-  ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config));
+  ntm_configure_sta(use_cache);
   ESP_ERROR_CHECK(esp_wifi_start());
+  // Between the few packets we exchange, only wake for every
+  // NTM_LISTEN_INTERVAL'th beacon
+  ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_MAX_MODEM));
 
-  ESP_LOGI(TAG, "wifi_init_sta finished.");
+  ESP_LOGI(TAG, "wifi_init_sta finished, %s", use_cache ? "using cached AP" : "scanning");
 }
 
-void ntm_init() {
-  s_ntm_event_group = xEventGroupCreate();
+void ntm_init_offline(const char *posix_tz) {
+  if (s_ntm_event_group == NULL) {
+    s_ntm_event_group = xEventGroupCreate();
+  }
+  bool restored = ntm_restore_clock(s_rtc_clock, "RTC memory");
+  if (posix_tz == NULL && restored && s_rtc_clock.posix_tz[0] != 0) {
+    posix_tz = s_rtc_clock.posix_tz;
+  }
+  if (posix_tz != NULL) {
+    ntm_set_posix_tz(posix_tz);
+  }
+}
 
-  xTaskCreate(&ntm_tz_fetch_task, "tz_fetch_task", 8192, NULL, tskIDLE_PRIORITY + 1,
-              &s_tz_fetch_task_handle);
+void ntm_init() {
+  ntm_load_tz_cache();
+  if (s_tz_cache_valid) {
+    ESP_LOGI(TAG, "Using cached TZ=%s for zone %s", s_tz_cache.posix_tz, s_tz_cache.zone);
+  }
+  ntm_init_offline(s_tz_cache_valid ? s_tz_cache.posix_tz : NULL);
+  if (!clock_is_set()) {
+    ntm_load_clock();
+  }
 
   ESP_ERROR_CHECK(esp_netif_init());
 
   ESP_ERROR_CHECK(esp_event_loop_create_default());
-  esp_netif_create_default_wifi_sta();
+  s_sta_netif = esp_netif_create_default_wifi_sta();
 
   wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
   ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -242,22 +705,69 @@ void ntm_init() {
   sntp_setservername(0, "pool.ntp.org");
 }
 
+bool ntm_reconfigure(const char *network_name, const char *network_pswd) {
+  if (!ntm_set_credentials(network_name, network_pswd)) {
+    return false;
+  }
+  if (!ntm_is_active()) {
+    // The next ntm_connect picks them up
+    return true;
+  }
+
+  // Only the station reconnects. WiFi, and with coexistence Bluetooth, stay
+  // up, which saves restarting the driver and the second or so that takes.
+  ntm_start_attempt();
+  xEventGroupClearBits(s_ntm_event_group, WIFI_CONNECTED_BIT);
+  bool use_cache = ntm_cache_matches();
+  esp_wifi_disconnect();
+  ntm_configure_sta(use_cache);
+  esp_wifi_connect();
+  ESP_LOGI(TAG, "credentials changed, reconnecting, %s",
+           use_cache ? "using cached AP" : "scanning");
+  return true;
+}
+
 void ntm_disconnect() {
+  if (!ntm_is_active()) {
+    // WiFi may not even be initialized if we resumed with ntm_init_offline
+    return;
+  }
   ESP_ERROR_CHECK(esp_wifi_stop());
   xEventGroupClearBits(s_ntm_event_group, WIFI_ACTIVE_BIT);
 }
 
 void ntm_set_offline_time(time_t hour, time_t min) {
-  ntm_set_posix_tz("UTC");
-
-  // We add the epoch time for Jan 1, 2020 to our manual time since we treat very old
-  // times as likely invalid in ntm_get_local_time.
-  const timeval tv = timeval{.tv_sec = JAN_1_2020_EPOCH + (hour * 60 + min) * 60};
+  // Only the time of day is given, so keep the timezone, and the date if
+  // there is one, rather than losing them. Very old times are treated as
+  // invalid in ntm_get_local_time, so without any date use Jan 1, 2020.
+  PosixTz tz;
+  if (!(xEventGroupGetBits(s_ntm_event_group) & TZ_READY_BIT)) {
+    ntm_set_posix_tz("UTC");
+  } else if (!tz.parse(s_posix_tz)) {
+    ESP_LOGW(TAG, "Unable to parse TZ=%s, setting the time as UTC", s_posix_tz);
+  }
+  bool date_known = clock_is_set();
+  time_t now = date_known ? time(NULL) : (s_last_known_time ? s_last_known_time : JAN_1_2020_EPOCH);
+
+  // Whichever day makes the smallest change, so 23:59 set just after
+  // midnight goes back a minute rather than on a day
+  int64_t local = now + tz.offset(now);
+  int64_t target = local - local % SECS_PER_DAY + (hour * 60 + min) * 60;
+  if (target - local > SECS_PER_DAY / 2) {
+    target -= SECS_PER_DAY;
+  } else if (local - target > SECS_PER_DAY / 2) {
+    target += SECS_PER_DAY;
+  }
+  const timeval tv = timeval{.tv_sec = tz.toUtc(target)};
 
   settimeofday(&tv, NULL);
+  // The jump isn't drift, so don't measure the next sync's offset against it
+  s_rtc_last_sync = 0;
+  ntm_record_clock(date_known ? NTM_MANUAL_CLOCK_ERROR_MS : UINT32_MAX);
   ESP_LOGI(TAG, "time set manually");
 
   xEventGroupSetBits(s_ntm_event_group, CLOCK_UPDATED_BIT);
+  events_post(EVENT_NETWORK);
 }
 
 bool ntm_has_error() {
@@ -272,6 +782,38 @@ bool ntm_poll_clock_updated() {
   return xEventGroupClearBits(s_ntm_event_group, CLOCK_UPDATED_BIT) & CLOCK_UPDATED_BIT;
 }
 
+uint32_t ntm_clock_error_ms() {
+  if (!clock_is_set() || !ntm_clock_record_valid(s_rtc_clock) ||
+      s_rtc_clock.error_ms == UINT32_MAX) {
+    return UINT32_MAX;
+  }
+  uint64_t elapsed_s = (esp_clk_rtc_time() - s_rtc_clock.rtc_us) / 1000000;
+  uint64_t error = (uint64_t)s_rtc_clock.error_ms +
+                   clock_drift_predicted_error_ms(
+                       s_rtc_drift, elapsed_s < UINT32_MAX ? (uint32_t)elapsed_s : UINT32_MAX);
+  return error < UINT32_MAX ? (uint32_t)error : UINT32_MAX - 1;
+}
+
+time_t ntm_next_sync_time() {
+  if (s_rtc_last_sync == 0 || !clock_is_set() ||
+      !(xEventGroupGetBits(s_ntm_event_group) & TZ_READY_BIT)) {
+    return 0;
+  }
+  return s_rtc_last_sync + ntm_sync_interval_s();
+}
+
+uint32_t ntm_sync_count() { return s_sync_count; }
+
+bool ntm_is_fetching_tz() { return s_tz_fetching; }
+
+bool ntm_get_posix_tz(char posix_tz[NTM_POSIX_TZ_SIZE]) {
+  if (!(xEventGroupGetBits(s_ntm_event_group) & TZ_READY_BIT)) {
+    return false;
+  }
+  strlcpy(posix_tz, s_posix_tz, NTM_POSIX_TZ_SIZE);
+  return true;
+}
+
 bool ntm_get_local_time(struct tm *info) {
   if (!(xEventGroupGetBits(s_ntm_event_group) & TZ_READY_BIT)) {
     return false;
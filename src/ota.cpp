@@ -0,0 +1,377 @@
+#include "ota.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+
+#include "bt.h"
+#include "helpers.h"
+#include "worker.h"
+
+// Incoming data fills one buffer while the worker writes the other to flash.
+// A sector each, so each write erases at most once.
+#define OTA_BUFFER_SIZE 4096
+#define OTA_SHA256_SIZE 32
+// The longest the host waits for the worker to hand a buffer back. Every GATT
+// operation waits behind it, and another job such as a timezone fetch can
+// hold the worker for far longer, so the update fails instead.
+#define OTA_BUFFER_WAIT_MS 2000
+
+#define OTA_CMD_BEGIN 1
+#define OTA_CMD_END 2
+#define OTA_CMD_ABORT 3
+
+#define OTA_CONTROL_WRITE_SIZE (1 + 4 + OTA_SHA256_SIZE)
+#define OTA_CONTROL_READ_SIZE (1 + 4 + 4 + 4)
+// The longest an attribute value can be, so any MTU fits
+#define OTA_DATA_MAX_WRITE 512
+
+static const char *TAG = "ota";
+
+struct OtaBuffer {
+  uint8_t data[OTA_BUFFER_SIZE];
+  size_t size;
+  // The update it was filled for, so writes queued before an abort or a new
+  // BEGIN are dropped
+  uint32_t session;
+  // Set while the buffer is handed to the worker, under s_buffers_lock
+  bool queued;
+};
+
+// Data arrives on the Bluetooth host task, which fills s_buffers[s_filling]
+// and hands full buffers to the worker. Everything touching flash, the handle
+// and the hash runs on the worker, one job at a time.
+static OtaBuffer s_buffers[2];
+static size_t s_filling;
+static portMUX_TYPE s_buffers_lock = portMUX_INITIALIZER_UNLOCKED;
+// Given by the worker whenever it hands a buffer back, to wake a host waiting
+// for one. Waiters recheck `queued`, so a give nobody waited for is harmless.
+static SemaphoreHandle_t s_buffer_freed;
+static uint32_t s_session;
+static OtaState s_state;
+
+static uint32_t s_image_size;
+static uint32_t s_received;
+static uint8_t s_expected_sha[OTA_SHA256_SIZE];
+static uint64_t s_started_ms;
+static uint32_t s_bytes_per_sec;
+static bool s_restart_due;
+
+// Only touched by worker jobs
+static const esp_partition_t *s_partition;
+static esp_ota_handle_t s_handle;
+static bool s_handle_open;
+static mbedtls_sha256_context s_sha;
+static bool s_sha_live;
+
+static char s_control_buf[std::max(OTA_CONTROL_WRITE_SIZE, OTA_CONTROL_READ_SIZE)];
+static char s_data_buf[OTA_DATA_MAX_WRITE];
+
+static void put_u32(uint8_t *out, uint32_t value) {
+  for (size_t i = 0; i < 4; i++) {
+    out[i] = value >> (8 * i);
+  }
+}
+
+static uint32_t get_u32(const uint8_t *in) {
+  return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static void ota_fail(const char *reason, esp_err_t err) {
+  ESP_LOGE(TAG, "Update failed, %s: %s", reason, esp_err_to_name(err));
+  s_state = OTA_FAILED;
+}
+
+// The hardware SHA engine stays locked while a context is live, so every
+// context begun is freed, whichever way the update ends
+static void ota_free_sha() {
+  if (s_sha_live) {
+    mbedtls_sha256_free(&s_sha);
+    s_sha_live = false;
+  }
+}
+
+static void ota_close() {
+  if (s_handle_open) {
+    esp_ota_abort(s_handle);
+    s_handle_open = false;
+  }
+  ota_free_sha();
+}
+
+static void ota_close_job(void *arg) { ota_close(); }
+
+static void ota_begin_job(void *arg) {
+  if ((uint32_t)(uintptr_t)arg != s_session) {
+    return;
+  }
+  ota_close();
+
+  mbedtls_sha256_init(&s_sha);
+  s_sha_live = true;
+  mbedtls_sha256_starts(&s_sha, 0);
+  s_partition = esp_ota_get_next_update_partition(NULL);
+  if (s_partition == NULL) {
+    ota_fail("no partition", ESP_ERR_NOT_FOUND);
+    return;
+  }
+  if (s_image_size > s_partition->size) {
+    ota_fail("image too large", ESP_ERR_INVALID_SIZE);
+    return;
+  }
+  // Erases each sector as it's first written rather than the whole image up
+  // front, which would stall the transfer for seconds
+  esp_err_t err = esp_ota_begin(s_partition, OTA_WITH_SEQUENTIAL_WRITES, &s_handle);
+  if (err != ESP_OK) {
+    ota_fail("begin", err);
+    return;
+  }
+  s_handle_open = true;
+  ESP_LOGI(TAG, "Writing %lu bytes to %s", s_image_size, s_partition->label);
+}
+
+static void ota_write_job(void *arg) {
+  OtaBuffer *buffer = (OtaBuffer *)arg;
+  if (buffer->session == s_session && s_handle_open && s_state != OTA_FAILED) {
+    mbedtls_sha256_update(&s_sha, buffer->data, buffer->size);
+    esp_err_t err = esp_ota_write(s_handle, buffer->data, buffer->size);
+    if (err != ESP_OK) {
+      ota_fail("write", err);
+    }
+  }
+  buffer->size = 0;
+  portENTER_CRITICAL(&s_buffers_lock);
+  buffer->queued = false;
+  portEXIT_CRITICAL(&s_buffers_lock);
+  xSemaphoreGive(s_buffer_freed);
+}
+
+static void ota_end_job(void *arg) {
+  if ((uint32_t)(uintptr_t)arg != s_session) {
+    return;
+  }
+  if (s_state == OTA_FAILED || !s_handle_open) {
+    ota_close();
+    return;
+  }
+
+  uint8_t sha[OTA_SHA256_SIZE];
+  mbedtls_sha256_finish(&s_sha, sha);
+  ota_free_sha();
+  if (memcmp(sha, s_expected_sha, sizeof(sha)) != 0) {
+    ota_close();
+    ota_fail("hash mismatch", ESP_ERR_INVALID_CRC);
+    return;
+  }
+
+  // Also checks the image is one the bootloader will accept
+  s_handle_open = false;
+  esp_err_t err = esp_ota_end(s_handle);
+  if (err == ESP_OK) {
+    err = esp_ota_set_boot_partition(s_partition);
+  }
+  if (err != ESP_OK) {
+    ota_fail("end", err);
+    return;
+  }
+
+  uint64_t elapsed_ms = std::max<uint64_t>(millis64() - s_started_ms, 1);
+  s_bytes_per_sec = (uint64_t)s_image_size * 1000 / elapsed_ms;
+  ESP_LOGI(TAG, "Updated %lu bytes in %llums, %lu.%lu KB/s", s_image_size, elapsed_ms,
+           s_bytes_per_sec / 1024, s_bytes_per_sec % 1024 * 10 / 1024);
+  s_state = OTA_DONE;
+  s_restart_due = true;
+}
+
+static bool ota_filling_free() {
+  portENTER_CRITICAL(&s_buffers_lock);
+  bool free = !s_buffers[s_filling].queued;
+  portEXIT_CRITICAL(&s_buffers_lock);
+  return free;
+}
+
+// Waits up to OTA_BUFFER_WAIT_MS for the worker to be done with the buffer to
+// fill next. Returns false if it still isn't.
+static bool ota_take_filling() {
+  TickType_t start = xTaskGetTickCount();
+  TickType_t wait = pdMS_TO_TICKS(OTA_BUFFER_WAIT_MS);
+  while (!ota_filling_free()) {
+    TickType_t waited = xTaskGetTickCount() - start;
+    if (waited >= wait || xSemaphoreTake(s_buffer_freed, wait - waited) != pdTRUE) {
+      return ota_filling_free();
+    }
+  }
+  return true;
+}
+
+// Hands the buffer being filled to the worker and moves on to the other,
+// waiting for the worker to finish with it first. The wait holds back the
+// host, and through it the peer, whenever flash falls behind.
+static void ota_submit_filling() {
+  OtaBuffer *buffer = &s_buffers[s_filling];
+  buffer->session = s_session;
+  portENTER_CRITICAL(&s_buffers_lock);
+  buffer->queued = true;
+  portEXIT_CRITICAL(&s_buffers_lock);
+  if (!worker_submit(ota_write_job, buffer)) {
+    ota_fail("queue full", ESP_ERR_NO_MEM);
+    buffer->size = 0;
+    portENTER_CRITICAL(&s_buffers_lock);
+    buffer->queued = false;
+    portEXIT_CRITICAL(&s_buffers_lock);
+    return;
+  }
+  s_filling ^= 1;
+  if (!ota_take_filling()) {
+    // Drops the writes still queued. Each buffer is taken back once the
+    // worker has given it up, so the next BEGIN has both again.
+    s_session++;
+    ota_fail("flash writes fell behind", ESP_ERR_TIMEOUT);
+  }
+}
+
+static int ota_begin(const uint8_t *in, size_t size) {
+  if (size != OTA_CONTROL_WRITE_SIZE || s_state == OTA_VERIFYING || !ota_take_filling()) {
+    return 1;
+  }
+
+  s_session++;
+  s_image_size = get_u32(in + 1);
+  memcpy(s_expected_sha, in + 5, OTA_SHA256_SIZE);
+  s_received = 0;
+  s_buffers[s_filling].size = 0;
+  s_started_ms = millis64();
+  s_state = OTA_RECEIVING;
+  if (!worker_submit(ota_begin_job, (void *)(uintptr_t)s_session)) {
+    ota_fail("queue full", ESP_ERR_NO_MEM);
+    return 1;
+  }
+  return 0;
+}
+
+static int ota_end() {
+  if (s_state != OTA_RECEIVING || s_received != s_image_size) {
+    ESP_LOGE(TAG, "Ended with %lu of %lu bytes", s_received, s_image_size);
+    return 1;
+  }
+
+  if (s_buffers[s_filling].size > 0) {
+    ota_submit_filling();
+    if (s_state != OTA_RECEIVING) {
+      return 1;
+    }
+  }
+  s_state = OTA_VERIFYING;
+  if (!worker_submit(ota_end_job, (void *)(uintptr_t)s_session)) {
+    ota_fail("queue full", ESP_ERR_NO_MEM);
+    return 1;
+  }
+  return 0;
+}
+
+static int ota_control_access_cb(size_t *bytes, const bt_chr *chr, BtOp op) {
+  uint8_t *buf = (uint8_t *)chr->buffer;
+  switch (op) {
+  case BtOp::REQUEST_READ:
+    buf[0] = s_state;
+    put_u32(buf + 1, s_received);
+    put_u32(buf + 5, s_image_size);
+    put_u32(buf + 9, s_bytes_per_sec);
+    *bytes = OTA_CONTROL_READ_SIZE;
+    break;
+  case BtOp::WRITTEN:
+    if (*bytes == 0) {
+      return 1;
+    }
+    switch (buf[0]) {
+    case OTA_CMD_BEGIN:
+      return ota_begin(buf, *bytes);
+    case OTA_CMD_END:
+      return ota_end();
+    case OTA_CMD_ABORT:
+      ESP_LOGI(TAG, "Aborted after %lu bytes", s_received);
+      s_session++;
+      s_state = OTA_IDLE;
+      if (ota_filling_free()) {
+        s_buffers[s_filling].size = 0;
+      }
+      worker_submit(ota_close_job, NULL);
+      return 0;
+    default:
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static int ota_data_access_cb(size_t *bytes, const bt_chr *chr, BtOp op) {
+  if (op != BtOp::WRITTEN || s_state != OTA_RECEIVING) {
+    return 1;
+  }
+  if (s_received + *bytes > s_image_size) {
+    ota_fail("more data than the image size", ESP_ERR_INVALID_SIZE);
+    return 1;
+  }
+
+  const uint8_t *in = (const uint8_t *)chr->buffer;
+  size_t left = *bytes;
+  while (left > 0 && s_state == OTA_RECEIVING) {
+    OtaBuffer &buffer = s_buffers[s_filling];
+    size_t n = std::min(left, OTA_BUFFER_SIZE - buffer.size);
+    memcpy(buffer.data + buffer.size, in, n);
+    buffer.size += n;
+    in += n;
+    left -= n;
+    if (buffer.size == OTA_BUFFER_SIZE) {
+      ota_submit_filling();
+    }
+  }
+  s_received += *bytes;
+
+  return 0;
+}
+
+void ota_register() {
+  s_buffer_freed = xSemaphoreCreateBinary();
+  assert(s_buffer_freed);
+
+  bt_register(bt_chr{.name = "ota control",
+                     .buffer = s_control_buf,
+                     .bufferSize = sizeof(s_control_buf),
+                     .readable = true,
+                     .writable = true,
+                     .access_cb = ota_control_access_cb});
+  bt_register(bt_chr{.name = "ota data",
+                     .buffer = s_data_buf,
+                     .bufferSize = sizeof(s_data_buf),
+                     .readable = false,
+                     .writable = true,
+                     .writeNoResponse = true,
+                     .access_cb = ota_data_access_cb});
+}
+
+bool ota_restart_due() { return s_restart_due; }
+
+void ota_confirm_boot() {
+  static bool checked;
+  if (checked) {
+    return;
+  }
+  checked = true;
+
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  esp_ota_img_states_t state;
+  if (esp_ota_get_state_partition(running, &state) == ESP_OK &&
+      state == ESP_OTA_IMG_PENDING_VERIFY) {
+    ESP_LOGI(TAG, "First boot of the update in %s, keeping it", running->label);
+    ESP_ERROR_CHECK(esp_ota_mark_app_valid_cancel_rollback());
+  }
+}
@@ -0,0 +1,147 @@
+#include "radio.h"
+
+#include <algorithm>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#include "helpers.h"
+#include "network_time_manager.h"
+
+static const char *TAG = "radio";
+
+// Backoff and usage carry across deep sleep
+RTC_DATA_ATTR static uint32_t s_rtc_backoff_s;
+RTC_DATA_ATTR static time_t s_rtc_retry_at;
+// Radio-on time since s_rtc_stats_since, 0 until the clock was first known
+RTC_DATA_ATTR static uint64_t s_rtc_on_ms;
+RTC_DATA_ATTR static time_t s_rtc_stats_since;
+RTC_DATA_ATTR static uint32_t s_rtc_windows;
+
+static bool s_open;
+static bool s_requested;
+static uint64_t s_opened_ms;
+// When the current connection attempt started, the window's timeout runs
+// from here
+static uint64_t s_attempt_ms;
+static uint32_t s_opened_sync_count;
+static time_t s_next_transition;
+
+static bool clock_known() {
+  struct tm info;
+  return ntm_get_local_time(&info);
+}
+
+static void close_window(const char *outcome) {
+  ntm_disconnect();
+  s_open = false;
+
+  uint64_t on_ms = millis64() - s_opened_ms;
+  time_t now = time(NULL);
+  if (s_rtc_stats_since == 0 && clock_known()) {
+    // Anything counted before the clock was set can't be spread over days
+    s_rtc_stats_since = now - on_ms / 1000;
+    s_rtc_on_ms = 0;
+  }
+  s_rtc_on_ms += on_ms;
+  s_rtc_windows++;
+
+  time_t elapsed = std::max<time_t>(now - s_rtc_stats_since, 1);
+  ESP_LOGI(TAG, "Window %s after %llums; radio on %llus/day over %ld windows", outcome, on_ms,
+           s_rtc_stats_since == 0 ? 0 : s_rtc_on_ms * 24 * 60 * 60 / 1000 / elapsed,
+           (long)s_rtc_windows);
+}
+
+bool radio_window_due(time_t next_transition) {
+  s_next_transition = next_transition;
+  if (s_open || s_rtc_retry_at > time(NULL)) {
+    return false;
+  }
+  if (s_requested) {
+    return true;
+  }
+
+  time_t sync_at = ntm_next_sync_time();
+  if (sync_at == 0) {
+    return true;
+  }
+  // Nothing depends on the clock between transitions, so a sync falling due
+  // can wait for the next one.
+  return sync_at <= next_transition && time(NULL) >= next_transition - RADIO_WINDOW_LEAD_S;
+}
+
+void radio_open_window(const char *network_name, const char *network_pswd) {
+  ESP_LOGI(TAG, "Opening window%s", s_requested ? " on request" : "");
+  s_open = true;
+  s_requested = false;
+  s_opened_ms = millis64();
+  s_attempt_ms = s_opened_ms;
+  s_opened_sync_count = ntm_sync_count();
+  ntm_connect(network_name, network_pswd);
+}
+
+void radio_set_credentials(const char *network_name, const char *network_pswd) {
+  if (!ntm_reconfigure(network_name, network_pswd)) {
+    return;
+  }
+
+  s_rtc_backoff_s = 0;
+  s_rtc_retry_at = 0;
+  if (s_open) {
+    ESP_LOGI(TAG, "Reconnecting window with new credentials");
+    s_attempt_ms = millis64();
+    s_opened_sync_count = ntm_sync_count();
+  } else {
+    s_requested = true;
+  }
+}
+
+void radio_poll() {
+  if (!s_open) {
+    return;
+  }
+
+  // Once the clock is synced the window has done its job. Only a timezone
+  // lookup the sync started still needs the connection; other work queued on
+  // the worker, like an OTA write, doesn't, so it can't hold the radio up.
+  bool timed_out = millis64() - s_attempt_ms >= RADIO_WINDOW_TIMEOUT_S * 1000;
+  if (ntm_sync_count() != s_opened_sync_count && clock_known() &&
+      (!ntm_is_fetching_tz() || timed_out)) {
+    // A refresh cut short leaves the cached zone in place until the next window
+    close_window(timed_out ? "done, timezone refresh cut short" : "done");
+    s_rtc_backoff_s = 0;
+    s_rtc_retry_at = 0;
+    return;
+  }
+
+  if (ntm_has_error() || timed_out) {
+    close_window(timed_out ? "timed out" : "failed");
+    s_rtc_backoff_s = s_rtc_backoff_s == 0
+                          ? RADIO_BACKOFF_MIN_S
+                          : std::min<uint32_t>(s_rtc_backoff_s * 2, RADIO_BACKOFF_MAX_S);
+    s_rtc_retry_at = time(NULL) + s_rtc_backoff_s;
+    ESP_LOGW(TAG, "Retrying in %lus", (unsigned long)s_rtc_backoff_s);
+  }
+}
+
+uint64_t radio_next_update_millis() {
+  uint64_t now_ms = millis64();
+  if (s_open) {
+    return s_attempt_ms + RADIO_WINDOW_TIMEOUT_S * 1000;
+  }
+
+  time_t now = time(NULL);
+  time_t at;
+  if (s_rtc_retry_at > now) {
+    at = s_rtc_retry_at;
+  } else if (s_requested || ntm_next_sync_time() == 0) {
+    return now_ms;
+  } else if (ntm_next_sync_time() <= s_next_transition) {
+    at = s_next_transition - RADIO_WINDOW_LEAD_S;
+  } else {
+    return UINT64_MAX;
+  }
+  return at > now ? now_ms + (uint64_t)(at - now) * 1000 : now_ms;
+}
+
+bool radio_window_open() { return s_open; }
@@ -0,0 +1,119 @@
+#include "worker.h"
+
+#include <stdint.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "events.h"
+
+// Every other module keeps at most one job queued: a config flush, a clock
+// save and a timezone fetch. An OTA update can have four: closing the last
+// update, beginning the next and writing both buffers. The extra slot covers
+// its final write and END overlapping.
+#define WORKER_QUEUE_LENGTH 8
+// Jobs run one at a time, so this only needs to cover the deepest one. Those
+// are the plain HTTP timezone fetch through esp_http_client and lwIP DNS, and
+// esp_ota_end, which verifies the whole image before the boot partition is
+// switched. Each is around 3.5KB deep, with up to 1KB more for a log line
+// formatted on top. The rest is headroom. The task logs the least free stack
+// seen whenever it exits, and warns about any job that leaves less than
+// WORKER_STACK_MIN_FREE.
+#define WORKER_STACK_SIZE 6144
+#define WORKER_STACK_MIN_FREE 768
+#define WORKER_PRIORITY (tskIDLE_PRIORITY + 1)
+
+static const char *TAG = "WORKER";
+
+struct Job {
+  worker_job_fn fn;
+  void *arg;
+};
+
+// A ring of pending jobs. The running job stays at s_head until it returns so
+// worker_is_busy covers it.
+static Job s_jobs[WORKER_QUEUE_LENGTH];
+static size_t s_head;
+static size_t s_count;
+// Set from submitting the first job until the task has found the queue empty
+static bool s_running;
+static size_t s_min_free_stack = SIZE_MAX;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void worker_task(void *pvParameters) {
+  uint32_t jobs = 0;
+  size_t last_free_stack = SIZE_MAX;
+  while (true) {
+    portENTER_CRITICAL(&s_lock);
+    if (s_count == 0) {
+      s_running = false;
+      portEXIT_CRITICAL(&s_lock);
+      break;
+    }
+    Job job = s_jobs[s_head];
+    portEXIT_CRITICAL(&s_lock);
+
+    job.fn(job.arg);
+    jobs++;
+    size_t free_stack = uxTaskGetStackHighWaterMark(NULL);
+    // The high water mark only moves when a job goes deeper than any before
+    if (free_stack < last_free_stack && free_stack < WORKER_STACK_MIN_FREE) {
+      ESP_LOGW(TAG, "Job %p left only %u bytes of stack free", job.fn, free_stack);
+    }
+    last_free_stack = free_stack;
+
+    portENTER_CRITICAL(&s_lock);
+    s_head = (s_head + 1) % WORKER_QUEUE_LENGTH;
+    s_count--;
+    if (free_stack < s_min_free_stack) {
+      s_min_free_stack = free_stack;
+    }
+    portEXIT_CRITICAL(&s_lock);
+  }
+
+  ESP_LOGI(TAG, "Ran %lu jobs, min free stack %u of %u bytes", jobs, s_min_free_stack,
+           WORKER_STACK_SIZE);
+  // The main task may be holding off sleep until we're done
+  events_post(EVENT_WORKER);
+  vTaskDelete(NULL);
+}
+
+bool worker_submit(worker_job_fn fn, void *arg) {
+  portENTER_CRITICAL(&s_lock);
+  if (s_count == WORKER_QUEUE_LENGTH) {
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGW(TAG, "Queue full, dropping job");
+    return false;
+  }
+  s_jobs[(s_head + s_count) % WORKER_QUEUE_LENGTH] = Job{fn, arg};
+  s_count++;
+  bool start = !s_running;
+  s_running = true;
+  portEXIT_CRITICAL(&s_lock);
+
+  if (start && xTaskCreate(&worker_task, "worker", WORKER_STACK_SIZE, NULL, WORKER_PRIORITY,
+                           NULL) != pdPASS) {
+    ESP_LOGE(TAG, "Unable to create worker task, dropping queued jobs");
+    portENTER_CRITICAL(&s_lock);
+    s_count = 0;
+    s_running = false;
+    portEXIT_CRITICAL(&s_lock);
+    return false;
+  }
+  return true;
+}
+
+bool worker_is_busy() {
+  portENTER_CRITICAL(&s_lock);
+  bool running = s_running;
+  portEXIT_CRITICAL(&s_lock);
+  return running;
+}
+
+size_t worker_min_free_stack() {
+  portENTER_CRITICAL(&s_lock);
+  size_t min_free_stack = s_min_free_stack;
+  portEXIT_CRITICAL(&s_lock);
+  return min_free_stack;
+}
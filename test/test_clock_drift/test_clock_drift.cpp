@@ -0,0 +1,169 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "ClockDrift.h"
+
+#define MAX_ERROR_MS 30000
+#define MIN_INTERVAL_S (15 * 60)
+#define MAX_INTERVAL_S (7 * 24 * 60 * 60)
+#define DAY_S (24 * 60 * 60)
+// Typical SNTP error over WiFi
+#define SYNC_NOISE_MS 50
+
+typedef double (*drift_fn)(uint64_t t_s);
+
+struct SimResult {
+  // Largest error the clock actually reached just before a sync
+  double worst_error_ms;
+  // Same, but only counting syncs from `settle_s` on
+  double settled_worst_error_ms;
+  uint32_t syncs;
+  uint32_t last_interval_s;
+  ClockDrift drift;
+};
+
+static uint32_t s_seed;
+
+// Deterministic so failures reproduce
+static double noise_ms() {
+  s_seed = s_seed * 1103515245 + 12345;
+  return ((double)((s_seed >> 8) % 2001) / 1000.0 - 1.0) * SYNC_NOISE_MS;
+}
+
+// Runs the device's sync loop against a clock drifting at `drift_ppm(t)`.
+// Each sync measures the true error plus SNTP noise, and leaves the clock off
+// by that noise.
+static SimResult simulate(drift_fn drift_ppm, uint64_t duration_s, uint64_t settle_s) {
+  SimResult result{};
+  s_seed = 1;
+  uint64_t t = 0;
+  double residual_ms = noise_ms();
+
+  while (t < duration_s) {
+    uint32_t interval = clock_drift_next_interval_s(result.drift, MAX_ERROR_MS, MIN_INTERVAL_S,
+                                                    MAX_INTERVAL_S);
+    // Integrate a minute at a time so drift can wander within an interval
+    double error_ms = residual_ms;
+    for (uint32_t s = 0; s < interval; s += 60) {
+      error_ms += drift_ppm(t + s) * fmin(60, interval - s) / 1000;
+    }
+    t += interval;
+
+    residual_ms = noise_ms();
+    clock_drift_add_sample(result.drift, (int32_t)lround(error_ms - residual_ms), interval);
+
+    result.worst_error_ms = fmax(result.worst_error_ms, fabs(error_ms));
+    if (t - interval >= settle_s) {
+      result.settled_worst_error_ms = fmax(result.settled_worst_error_ms, fabs(error_ms));
+    }
+    result.syncs++;
+    result.last_interval_s = interval;
+  }
+  return result;
+}
+
+static void report(const char *name, const SimResult &result, uint64_t duration_s) {
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%s: %u syncs in %llu days, worst %.0fms, rate %.1fppm, last %us",
+           name, result.syncs, (unsigned long long)(duration_s / DAY_S), result.worst_error_ms,
+           result.drift.rate_ppb / 1000.0, result.last_interval_s);
+  TEST_MESSAGE(msg);
+}
+
+void test_no_samples() {
+  ClockDrift drift{};
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, clock_drift_predicted_error_ms(drift, 60));
+  TEST_ASSERT_EQUAL_UINT32(MIN_INTERVAL_S, clock_drift_next_interval_s(drift, MAX_ERROR_MS,
+                                                                       MIN_INTERVAL_S,
+                                                                       MAX_INTERVAL_S));
+}
+
+void test_rejects_bad_samples() {
+  ClockDrift drift{};
+  // Too soon after the last sync to mean anything
+  TEST_ASSERT_FALSE(clock_drift_add_sample(drift, 1000, CLOCK_DRIFT_MIN_SAMPLE_S - 1));
+  // An hour off after an hour is a clock set by hand
+  TEST_ASSERT_FALSE(clock_drift_add_sample(drift, 3600 * 1000, 3600));
+  TEST_ASSERT_EQUAL(0, drift.samples);
+
+  TEST_ASSERT_TRUE(clock_drift_add_sample(drift, -360, 3600));
+  TEST_ASSERT_EQUAL(-100000, drift.rate_ppb);
+  TEST_ASSERT_EQUAL(1, drift.samples);
+}
+
+void test_interval_growth_is_capped() {
+  ClockDrift drift{};
+  // A perfect first sample would allow the maximum straight away
+  TEST_ASSERT_TRUE(clock_drift_add_sample(drift, 0, MIN_INTERVAL_S));
+  TEST_ASSERT_EQUAL_UINT32(2 * MIN_INTERVAL_S, clock_drift_next_interval_s(drift, MAX_ERROR_MS,
+                                                                           MIN_INTERVAL_S,
+                                                                           MAX_INTERVAL_S));
+}
+
+static double crystal(uint64_t t_s) { return 20; }
+
+void test_crystal_backs_off_to_max() {
+  uint64_t duration = 60 * DAY_S;
+  SimResult result = simulate(&crystal, duration, 0);
+  report("crystal", result, duration);
+
+  TEST_ASSERT_TRUE(result.worst_error_ms < MAX_ERROR_MS);
+  TEST_ASSERT_EQUAL_UINT32(MAX_INTERVAL_S, result.last_interval_s);
+  TEST_ASSERT_INT_WITHIN(500, 20000, result.drift.rate_ppb);
+}
+
+static double rc_oscillator(uint64_t t_s) { return -15000; }
+
+void test_rc_oscillator_stays_in_bound() {
+  uint64_t duration = 7 * DAY_S;
+  SimResult result = simulate(&rc_oscillator, duration, 0);
+  report("rc", result, duration);
+
+  TEST_ASSERT_TRUE(result.worst_error_ms < MAX_ERROR_MS);
+  TEST_ASSERT_INT_WITHIN(150000, -15000000, result.drift.rate_ppb);
+  // Close to the bound rather than stuck at the minimum
+  TEST_ASSERT_TRUE(result.last_interval_s > MAX_ERROR_MS / 15 / 2);
+}
+
+// The RC oscillator swinging with the daily temperature cycle
+static double temperature_cycle(uint64_t t_s) {
+  return 5000 + 1500 * sin(2 * M_PI * (double)t_s / DAY_S);
+}
+
+void test_wandering_drift_stays_in_bound() {
+  uint64_t duration = 14 * DAY_S;
+  SimResult result = simulate(&temperature_cycle, duration, 0);
+  report("temperature", result, duration);
+
+  TEST_ASSERT_TRUE(result.worst_error_ms < MAX_ERROR_MS);
+}
+
+// The crystal until the device starts spending its time in deep sleep
+static double step_change(uint64_t t_s) { return t_s < 30 * DAY_S ? 20 : 3000; }
+
+void test_recovers_from_step_change() {
+  uint64_t duration = 60 * DAY_S;
+  SimResult result = simulate(&step_change, duration, 32 * DAY_S);
+  report("step", result, duration);
+
+  // Nothing predicts the step, so the sync straddling it overshoots, but the
+  // estimator must pull the error back by the next sync or two.
+  TEST_ASSERT_TRUE(result.settled_worst_error_ms < MAX_ERROR_MS);
+  TEST_ASSERT_INT_WITHIN(100000, 3000000, result.drift.rate_ppb);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_no_samples);
+  RUN_TEST(test_rejects_bad_samples);
+  RUN_TEST(test_interval_growth_is_capped);
+  RUN_TEST(test_crystal_backs_off_to_max);
+  RUN_TEST(test_rc_oscillator_stays_in_bound);
+  RUN_TEST(test_wandering_drift_stays_in_bound);
+  RUN_TEST(test_recovers_from_step_change);
+  UNITY_END();
+
+  return 0;
+}
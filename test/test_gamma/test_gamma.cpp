@@ -0,0 +1,83 @@
+#include <chrono>
+#include <stdio.h>
+#include <unity.h>
+
+#include "Gamma.h"
+
+void test_table_monotonic() {
+  char msg[24];
+  constexpr GammaTable table = gamma_make_table();
+
+  TEST_ASSERT_EQUAL(0, table.duty[0]);
+  TEST_ASSERT_EQUAL(GAMMA_DUTY_MAX, table.duty[GAMMA_LEVELS - 1]);
+  for (int i = 1; i < GAMMA_LEVELS; i++) {
+    snprintf(msg, sizeof(msg), "level %d", i);
+    // Strictly increasing so every user-visible level is distinct
+    TEST_ASSERT_TRUE_MESSAGE(table.duty[i - 1] < table.duty[i], msg);
+  }
+}
+
+void test_duty_monotonic() {
+  char msg[24];
+  uint16_t last = gamma_duty(0);
+
+  for (uint32_t level = 1; level <= GAMMA_LEVEL(GAMMA_LEVELS - 1); level++) {
+    uint16_t duty = gamma_duty(level);
+    snprintf(msg, sizeof(msg), "level 0x%04x", level);
+    TEST_ASSERT_TRUE_MESSAGE(last <= duty, msg);
+    TEST_ASSERT_TRUE_MESSAGE(duty <= GAMMA_DUTY_MAX, msg);
+    last = duty;
+  }
+}
+
+void test_duty_matches_table() {
+  constexpr GammaTable table = gamma_make_table();
+  for (int i = 0; i < GAMMA_LEVELS; i++) {
+    TEST_ASSERT_EQUAL(table.duty[i], gamma_duty(GAMMA_LEVEL(i)));
+  }
+}
+
+void test_fade_level() {
+  TEST_ASSERT_EQUAL(GAMMA_LEVEL(0), gamma_fade_level(GAMMA_LEVEL(0), GAMMA_LEVEL(255), 0, 1000));
+  TEST_ASSERT_EQUAL(GAMMA_LEVEL(255),
+                    gamma_fade_level(GAMMA_LEVEL(0), GAMMA_LEVEL(255), 1000, 1000));
+  TEST_ASSERT_EQUAL(GAMMA_LEVEL(255),
+                    gamma_fade_level(GAMMA_LEVEL(0), GAMMA_LEVEL(255), 5000, 1000));
+  TEST_ASSERT_EQUAL(GAMMA_LEVEL(100),
+                    gamma_fade_level(GAMMA_LEVEL(200), GAMMA_LEVEL(0), 500, 1000));
+  // Long fades still land between levels instead of overflowing
+  TEST_ASSERT_EQUAL(GAMMA_LEVEL(255) / 2,
+                    gamma_fade_level(GAMMA_LEVEL(0), GAMMA_LEVEL(255), 1800000, 3600000));
+}
+
+void bench_tick() {
+  char msg[64];
+  const uint32_t duration = 30000;
+  const int iterations = 1000000;
+  uint32_t sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    uint16_t level =
+        gamma_fade_level(GAMMA_LEVEL(0), GAMMA_LEVEL(255), (uint32_t)i % duration, duration);
+    sink += gamma_duty(level);
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+
+  snprintf(msg, sizeof(msg), "fade tick: %5.2f ns (%u)", (double)ns / iterations, sink % 10);
+  TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_table_monotonic);
+  RUN_TEST(test_duty_monotonic);
+  RUN_TEST(test_duty_matches_table);
+  RUN_TEST(test_fade_level);
+  RUN_TEST(bench_tick);
+  UNITY_END();
+
+  return 0;
+}
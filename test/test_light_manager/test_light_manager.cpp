@@ -0,0 +1,451 @@
+#include "time.h"
+#include <chrono>
+#include <stdlib.h>
+#include <unity.h>
+#include <vector>
+
+#include "LightManager.h"
+#include "PosixTz.h"
+
+using Action = LightManager::Action;
+using Actions = LightManager::Actions;
+using Color = LightManager::Color;
+using HrMin = LightManager::HrMin;
+using Next = LightManager::Next;
+using Profile = LightManager::Profile;
+using Profiles = LightManager::Profiles;
+using Timeline = LightManager::Timeline;
+
+static const Color COLOR_OFF{0, 0, 0};
+static const Color COLOR_WHITE{255, 255, 255};
+static const Color COLOR_RED{255, 25, 20};
+static const Color COLOR_GREEN{30, 90, 0};
+
+struct TestCase {
+  HrMin now;
+  Color color;
+  uint32_t nextUpdateSecs;
+};
+
+// The linear scan LightManager used before it was indexed. Kept as a reference
+// for equivalence checks and benchmarks.
+int cmpHrMin(HrMin t1, HrMin t2) {
+  if (t1.hour == t2.hour && t1.minute == t2.minute) {
+    return 0;
+  } else if (t1.hour > t2.hour || (t1.hour == t2.hour && t1.minute > t2.minute)) {
+    return 1;
+  } else {
+    return -1;
+  }
+}
+
+Next scanUpdate(const Actions &actions, tm timeinfo) {
+  HrMin now{(uint8_t)timeinfo.tm_hour, (uint8_t)timeinfo.tm_min};
+  Action before = actions.back();
+  Action after = actions.front();
+  for (size_t i = 0; i < actions.size(); i++) {
+    if (cmpHrMin(actions[i].time, now) == 1) {
+      after = actions[i];
+      break;
+    }
+    before = actions[i];
+  }
+
+  int next_update_hrs = after.time.hour - now.hour;
+  if (cmpHrMin(after.time, now) < 0) {
+    next_update_hrs += 24;
+  }
+
+  return Next{.color = before.color,
+              .nextUpdateSecs = (uint32_t)((next_update_hrs * 60 + (after.time.minute - now.minute)) *
+                                               60 -
+                                           timeinfo.tm_sec)};
+}
+
+// Evenly spaced actions alternating between two colors
+Actions makeActions(size_t n) {
+  Actions actions;
+  for (size_t i = 0; i < n; i++) {
+    uint16_t minute = i * (24 * 60) / n;
+    actions.push_back(
+        Action{HrMin{(uint8_t)(minute / 60), (uint8_t)(minute % 60)}, i % 2 ? COLOR_RED : COLOR_WHITE});
+  }
+  return actions;
+}
+
+void test_actions() {
+  char msg[12];
+
+  std::vector<TestCase> testCases{{HrMin{0, 0}, COLOR_OFF, 80 * 60},
+                                  {HrMin{1, 20}, COLOR_WHITE, 70 * 60},
+                                  {HrMin{1, 21}, COLOR_WHITE, 69 * 60},
+                                  {HrMin{2, 30}, COLOR_OFF, (22 * 60 + 50) * 60},
+                                  {HrMin{2, 31}, COLOR_OFF, (22 * 60 + 49) * 60}};
+
+  Profiles profiles{Profile{"default",
+                                        {
+                                            Action{HrMin{1, 20}, COLOR_WHITE},
+                                            Action{HrMin{2, 30}, COLOR_OFF},
+                                        }}};
+
+  LightManager lightManager(profiles);
+
+  for (TestCase &testCase : testCases) {
+    tm now{.tm_min = testCase.now.minute, .tm_hour = testCase.now.hour};
+    Next actual = lightManager.update(now);
+    snprintf(msg, sizeof(msg), "At %02d:%02d", testCase.now.hour, testCase.now.minute);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(testCase.color.data(), actual.color.data(), 3, msg);
+    TEST_ASSERT_EQUAL_MESSAGE(testCase.nextUpdateSecs, actual.nextUpdateSecs, msg);
+  }
+}
+
+void test_actions_week_wrap() {
+  Profiles profiles{Profile{"default", {Action{HrMin{7, 0}, COLOR_WHITE}}}};
+  LightManager lightManager(profiles);
+
+  // Saturday night rolls over into Sunday morning
+  tm now{.tm_min = 0, .tm_hour = 23, .tm_wday = 6};
+  Next actual = lightManager.update(now);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(COLOR_WHITE.data(), actual.color.data(), 3);
+  TEST_ASSERT_EQUAL(8 * 60 * 60, actual.nextUpdateSecs);
+}
+
+void test_index_matches_scan() {
+  char msg[32];
+  size_t sizes[] = {2, 7, 100, LIGHT_MANAGER_MAX_ACTIONS};
+
+  for (size_t n : sizes) {
+    if (n > LIGHT_MANAGER_MAX_ACTIONS) {
+      continue;
+    }
+    Actions actions = makeActions(n);
+    Profiles profiles{Profile{"default", actions}};
+    LightManager lightManager(profiles);
+
+    for (int minute = 0; minute < 24 * 60; minute++) {
+      tm now{.tm_sec = 30, .tm_min = minute % 60, .tm_hour = minute / 60, .tm_wday = 3};
+      Next expect = scanUpdate(actions, now);
+      Next actual = lightManager.update(now);
+
+      snprintf(msg, sizeof(msg), "n=%zu at %02d:%02d", n, now.tm_hour, now.tm_min);
+      TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(expect.color.data(), actual.color.data(), 3, msg);
+      TEST_ASSERT_EQUAL_MESSAGE(expect.nextUpdateSecs, actual.nextUpdateSecs, msg);
+    }
+  }
+}
+
+void bench_index_vs_scan() {
+  char msg[96];
+  // 100 and 1000 need the capacity the native env builds with
+  size_t sizes[] = {7, 100, 1000};
+  const int iterations = 20000;
+
+  for (size_t n : sizes) {
+    if (n > LIGHT_MANAGER_MAX_ACTIONS) {
+      snprintf(msg, sizeof(msg), "n=%4zu skipped, over LIGHT_MANAGER_MAX_ACTIONS", n);
+      TEST_MESSAGE(msg);
+      continue;
+    }
+    Actions actions = makeActions(n);
+    Profiles profiles{Profile{"default", actions}};
+    LightManager lightManager(profiles);
+    uint32_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      tm now{.tm_min = i % 60, .tm_hour = (i / 60) % 24};
+      sink += scanUpdate(actions, now).nextUpdateSecs;
+    }
+    auto scanNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      tm now{.tm_min = i % 60, .tm_hour = (i / 60) % 24};
+      sink += lightManager.update(now).nextUpdateSecs;
+    }
+    auto indexNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+    snprintf(msg, sizeof(msg), "n=%4zu scan: %6.1f ns/update index: %6.1f ns/update (%u)", n,
+             (double)scanNs / iterations, (double)indexNs / iterations, sink % 10);
+    TEST_MESSAGE(msg);
+  }
+}
+
+void test_compile_weekday_weekend() {
+  Profiles profiles{
+      Profile{"daily", {Action{HrMin{7, 0}, COLOR_GREEN}, Action{HrMin{8, 0}, COLOR_OFF}}},
+      Profile{"weekend",
+              {
+                  Action{HrMin{8, 0}, COLOR_OFF},
+                  Action{HrMin{7, 0}, COLOR_GREEN, LightManager::WEEKDAYS},
+                  Action{HrMin{9, 0}, COLOR_GREEN, LightManager::WEEKEND},
+                  Action{HrMin{10, 0}, COLOR_OFF, LightManager::WEEKEND},
+              }},
+  };
+
+  Timeline timeline;
+  LightManager::compile(profiles, timeline);
+
+  TEST_ASSERT_EQUAL(3, timeline.offsets.size());
+  TEST_ASSERT_EQUAL(0, timeline.offsets[0]);
+  TEST_ASSERT_EQUAL(14, timeline.offsets[1]);
+  // 5 weekdays with 2 actions, 2 weekend days with 3 actions
+  TEST_ASSERT_EQUAL(14 + 5 * 2 + 2 * 3, timeline.offsets[2]);
+
+  for (size_t p = 0; p < profiles.size(); p++) {
+    for (size_t i = timeline.offsets[p] + 1; i < timeline.offsets[p + 1]; i++) {
+      TEST_ASSERT_TRUE(timeline.transitions[i - 1].minuteOfWeek <=
+                       timeline.transitions[i].minuteOfWeek);
+    }
+  }
+
+  // Sunday: off at 08:00, then 09:00 wake and 10:00 off
+  const LightManager::Transition *sunday = &timeline.transitions[timeline.offsets[1]];
+  TEST_ASSERT_EQUAL(8 * 60, sunday[0].minuteOfWeek);
+  TEST_ASSERT_EQUAL(0, sunday[0].action);
+  TEST_ASSERT_EQUAL(9 * 60, sunday[1].minuteOfWeek);
+  TEST_ASSERT_EQUAL(2, sunday[1].action);
+  TEST_ASSERT_EQUAL(10 * 60, sunday[2].minuteOfWeek);
+  // Monday starts with the weekday wake
+  TEST_ASSERT_EQUAL(24 * 60 + 7 * 60, sunday[3].minuteOfWeek);
+  TEST_ASSERT_EQUAL(1, sunday[3].action);
+}
+
+void test_switch_profile() {
+  Profiles profiles{
+      Profile{"daily", {Action{HrMin{7, 0}, COLOR_GREEN}, Action{HrMin{8, 0}, COLOR_OFF}}},
+      Profile{"weekend",
+              {
+                  Action{HrMin{7, 0}, COLOR_GREEN, LightManager::WEEKDAYS},
+                  Action{HrMin{8, 0}, COLOR_OFF, LightManager::WEEKDAYS},
+                  Action{HrMin{9, 0}, COLOR_GREEN, LightManager::WEEKEND},
+                  Action{HrMin{10, 0}, COLOR_OFF, LightManager::WEEKEND},
+              }},
+  };
+  LightManager lightManager(profiles);
+
+  // Saturday 07:30
+  tm now{.tm_min = 30, .tm_hour = 7, .tm_wday = 6};
+  Next actual = lightManager.update(now);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(COLOR_GREEN.data(), actual.color.data(), 3);
+  TEST_ASSERT_EQUAL(30 * 60, actual.nextUpdateSecs);
+
+  TEST_ASSERT_FALSE(lightManager.setProfile("missing"));
+  TEST_ASSERT_EQUAL(0, lightManager.profile());
+  TEST_ASSERT_TRUE(lightManager.setProfile("weekend"));
+  TEST_ASSERT_EQUAL(1, lightManager.profile());
+
+  // Still off from Friday, waking at 09:00
+  actual = lightManager.update(now);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(COLOR_OFF.data(), actual.color.data(), 3);
+  TEST_ASSERT_EQUAL(90 * 60, actual.nextUpdateSecs);
+
+  // Sunday 10:00 off until Monday 07:00
+  now = tm{.tm_min = 0, .tm_hour = 10, .tm_wday = 0};
+  actual = lightManager.update(now);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(COLOR_OFF.data(), actual.color.data(), 3);
+  TEST_ASSERT_EQUAL(21 * 60 * 60, actual.nextUpdateSecs);
+}
+
+void test_encode_decode() {
+  Actions actions{
+      Action{HrMin{7, 0}, COLOR_GREEN, LightManager::WEEKDAYS},
+      Action{HrMin{19, 30}, COLOR_RED},
+  };
+  uint8_t buf[LIGHT_MANAGER_MAX_ACTIONS * LIGHT_MANAGER_ACTION_SIZE];
+
+  size_t size = LightManager::encode(actions, buf);
+  TEST_ASSERT_EQUAL(2 * LIGHT_MANAGER_ACTION_SIZE, size);
+  // The stored layout must not change between releases
+  const uint8_t expect[]{7, 0, 30, 90, 0, LightManager::WEEKDAYS,
+                         19, 30, 255, 25, 20, LightManager::EVERY_DAY};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expect, buf, sizeof(expect));
+
+  Actions decoded;
+  TEST_ASSERT_TRUE(LightManager::decode(buf, size, decoded));
+  TEST_ASSERT_EQUAL(2, decoded.size());
+  for (size_t i = 0; i < decoded.size(); i++) {
+    TEST_ASSERT_EQUAL(actions[i].time.hour, decoded[i].time.hour);
+    TEST_ASSERT_EQUAL(actions[i].time.minute, decoded[i].time.minute);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(actions[i].color.data(), decoded[i].color.data(), 3);
+    TEST_ASSERT_EQUAL(actions[i].days, decoded[i].days);
+  }
+
+  // Partial records and more actions than fit are rejected
+  TEST_ASSERT_FALSE(LightManager::decode(buf, size - 1, decoded));
+  TEST_ASSERT_FALSE(LightManager::decode(
+      buf, (LIGHT_MANAGER_MAX_ACTIONS + 1) * LIGHT_MANAGER_ACTION_SIZE, decoded));
+  // So are schedules that never run
+  TEST_ASSERT_FALSE(LightManager::decode(buf, 0, decoded));
+  buf[LIGHT_MANAGER_ACTION_SIZE + 5] = 0;
+  TEST_ASSERT_FALSE(LightManager::decode(buf, size, decoded));
+}
+
+void test_no_transitions() {
+  Profiles profiles{Profile{"never", {Action{HrMin{7, 0}, COLOR_WHITE, 0}}}};
+  LightManager lightManager(profiles);
+
+  tm now{.tm_sec = 30, .tm_min = 0, .tm_hour = 12, .tm_wday = 2};
+  Next actual = lightManager.update(now);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(COLOR_OFF.data(), actual.color.data(), 3);
+  TEST_ASSERT_EQUAL(7 * 24 * 60 * 60, actual.nextUpdateSecs);
+
+  PosixTz tz;
+  TEST_ASSERT_EQUAL(0, lightManager.nextTransition(1700000000, tz));
+}
+
+#define HOUR (60 * 60)
+#define NEW_YORK "EST5EDT,M3.2.0,M11.1.0"
+
+// The UTC instant of a UTC date and time
+static time_t utc(int year, int month, int day, int hour, int minute) {
+  tm date{.tm_min = minute, .tm_hour = hour, .tm_mday = day, .tm_mon = month - 1,
+          .tm_year = year - 1900};
+  return timegm(&date);
+}
+
+// Three actions half an hour either side of 02:00, when clocks change
+static Profiles changeHourProfiles() {
+  return Profiles{Profile{"default",
+                          {Action{HrMin{0, 30}, COLOR_RED}, Action{HrMin{1, 30}, COLOR_GREEN},
+                           Action{HrMin{2, 30}, COLOR_WHITE}}}};
+}
+
+struct Wake {
+  time_t at;
+  Color color;
+};
+
+// Runs the schedule the way loop() does: sleep until the next planned
+// transition, then look the color up from the local time on waking
+static std::vector<Wake> wakes(LightManager &lightManager, const char *zone, time_t from,
+                               time_t to) {
+  PosixTz tz;
+  TEST_ASSERT_TRUE(tz.parse(zone));
+  setenv("TZ", zone, 1);
+  tzset();
+
+  std::vector<Wake> result;
+  for (time_t now = lightManager.nextTransition(from, tz); now != 0 && now <= to;
+       now = lightManager.nextTransition(now, tz)) {
+    tm local;
+    localtime_r(&now, &local);
+    result.push_back(Wake{now, lightManager.update(local).color});
+  }
+  unsetenv("TZ");
+  tzset();
+  return result;
+}
+
+static void assertWakes(const std::vector<Wake> &expect, const std::vector<Wake> &actual) {
+  char msg[32];
+  TEST_ASSERT_EQUAL(expect.size(), actual.size());
+  for (size_t i = 0; i < expect.size() && i < actual.size(); i++) {
+    snprintf(msg, sizeof(msg), "wake %zu", i);
+    TEST_ASSERT_EQUAL_MESSAGE(expect[i].at, actual[i].at, msg);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(expect[i].color.data(), actual[i].color.data(), 3, msg);
+  }
+}
+
+void test_plan_spring_forward() {
+  Profiles profiles = changeHourProfiles();
+  LightManager lightManager(profiles);
+
+  // 2024-03-10 02:00 EST jumps to 03:00 EDT, 07:00 UTC. The 02:30 action
+  // happens at the jump rather than being lost.
+  std::vector<Wake> expect{
+      {utc(2024, 3, 10, 5, 30), COLOR_RED},   {utc(2024, 3, 10, 6, 30), COLOR_GREEN},
+      {utc(2024, 3, 10, 7, 0), COLOR_WHITE},  {utc(2024, 3, 11, 4, 30), COLOR_RED},
+      {utc(2024, 3, 11, 5, 30), COLOR_GREEN}, {utc(2024, 3, 11, 6, 30), COLOR_WHITE},
+  };
+  assertWakes(expect, wakes(lightManager, NEW_YORK, utc(2024, 3, 10, 0, 0),
+                            utc(2024, 3, 11, 12, 0)));
+
+  time_t instants[LIGHT_MANAGER_PLAN_SIZE];
+  PosixTz tz;
+  tz.parse(NEW_YORK);
+  // Three local days, with today's transitions already past
+  size_t size = lightManager.plan(utc(2024, 3, 9, 12, 0), tz, instants);
+  TEST_ASSERT_EQUAL(9, size);
+  TEST_ASSERT_EQUAL(utc(2024, 3, 10, 5, 30), instants[0]);
+  TEST_ASSERT_EQUAL(utc(2024, 3, 12, 6, 30), instants[8]);
+}
+
+void test_plan_fall_back() {
+  Profiles profiles = changeHourProfiles();
+  LightManager lightManager(profiles);
+
+  // 2024-11-03 02:00 EDT goes back to 01:00 EST, 06:00 UTC. The 01:30 action
+  // only happens the first time round, and nothing wakes for the change.
+  std::vector<Wake> expect{
+      {utc(2024, 11, 3, 4, 30), COLOR_RED},   {utc(2024, 11, 3, 5, 30), COLOR_GREEN},
+      {utc(2024, 11, 3, 7, 30), COLOR_WHITE}, {utc(2024, 11, 4, 5, 30), COLOR_RED},
+      {utc(2024, 11, 4, 6, 30), COLOR_GREEN}, {utc(2024, 11, 4, 7, 30), COLOR_WHITE},
+  };
+  assertWakes(expect, wakes(lightManager, NEW_YORK, utc(2024, 11, 3, 0, 0),
+                            utc(2024, 11, 4, 12, 0)));
+}
+
+void test_plan_southern() {
+  Profiles profiles{Profile{"default", {Action{HrMin{7, 0}, COLOR_WHITE, LightManager::SUNDAY},
+                                        Action{HrMin{8, 0}, COLOR_OFF, LightManager::SUNDAY}}}};
+  LightManager lightManager(profiles);
+
+  // Sydney's clocks go forward on Sunday 2024-10-06, so the same wall clock
+  // times a week apart are an hour closer in UTC
+  std::vector<Wake> expect{
+      {utc(2024, 9, 28, 21, 0), COLOR_WHITE},
+      {utc(2024, 9, 28, 22, 0), COLOR_OFF},
+      {utc(2024, 10, 5, 20, 0), COLOR_WHITE},
+      {utc(2024, 10, 5, 21, 0), COLOR_OFF},
+  };
+  assertWakes(expect, wakes(lightManager, "AEST-10AEDT,M10.1.0,M4.1.0/3",
+                            utc(2024, 9, 27, 0, 0), utc(2024, 10, 7, 0, 0)));
+}
+
+void test_plan_kept_until_stale() {
+  Profiles profiles = changeHourProfiles();
+  LightManager lightManager(profiles);
+  PosixTz newYork, utcTz;
+  newYork.parse(NEW_YORK);
+  utcTz.parse("UTC0");
+  time_t now = utc(2024, 6, 1, 12, 0);
+
+  TEST_ASSERT_EQUAL(utc(2024, 6, 2, 4, 30), lightManager.nextTransition(now, newYork));
+  // A change of zone replans
+  TEST_ASSERT_EQUAL(utc(2024, 6, 2, 0, 30), lightManager.nextTransition(now, utcTz));
+
+  // So do edits to the actions
+  profiles[0].actions[0].time = HrMin{0, 15};
+  lightManager.invalidate();
+  TEST_ASSERT_EQUAL(utc(2024, 6, 2, 0, 15), lightManager.nextTransition(now, utcTz));
+
+  // Running off the end plans the days after
+  TEST_ASSERT_EQUAL(utc(2024, 6, 20, 0, 15),
+                    lightManager.nextTransition(utc(2024, 6, 20, 0, 0), utcTz));
+  // As does the clock going backwards
+  TEST_ASSERT_EQUAL(utc(2024, 6, 2, 0, 15), lightManager.nextTransition(now, utcTz));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_actions);
+  RUN_TEST(test_actions_week_wrap);
+  RUN_TEST(test_index_matches_scan);
+  RUN_TEST(test_compile_weekday_weekend);
+  RUN_TEST(test_switch_profile);
+  RUN_TEST(test_encode_decode);
+  RUN_TEST(test_no_transitions);
+  RUN_TEST(test_plan_spring_forward);
+  RUN_TEST(test_plan_fall_back);
+  RUN_TEST(test_plan_southern);
+  RUN_TEST(test_plan_kept_until_stale);
+  RUN_TEST(bench_index_vs_scan);
+  UNITY_END();
+
+  return 0;
+}
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#include "PosixTz.h"
+
+#define HOUR (60 * 60)
+#define DAY (24 * HOUR)
+
+// Every zone in the table with DST, plus a couple without. Between them they
+// use every rule form: M, J and plain day rules, times past midnight, past a
+// day and before midnight, and DST that spans the new year or goes backwards.
+static const char *ZONES[] = {
+    "<+00>0<+02>-2,M3.5.0/1,M10.5.0/3",
+    "<+0330>-3:30<+0430>,J79/24,J263/24",
+    "<+1030>-10:30<+11>-11,M10.1.0,M4.1.0",
+    "<+11>-11<+12>,M10.1.0,M4.1.0/3",
+    "<+1245>-12:45<+1345>,M9.5.0/2:45,M4.1.0/3:45",
+    "<+12>-12<+13>,M11.2.0,M1.2.3/99",
+    "<-01>1<+00>,M3.5.0/0,M10.5.0/1",
+    "<-03>3<-02>,M3.2.0,M11.1.0",
+    "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",
+    "<-04>4<-03>,M10.1.0/0,M3.4.0/0",
+    "<-04>4<-03>,M9.1.6/24,M4.1.6/24",
+    "<-06>6<-05>,M9.1.6/22,M4.1.6/22",
+    "ACST-9:30ACDT,M10.1.0,M4.1.0/3",
+    "AEST-10AEDT,M10.1.0,M4.1.0/3",
+    "AKST9AKDT,M3.2.0,M11.1.0",
+    "AST4ADT,M3.2.0,M11.1.0",
+    "CET-1CEST,M3.5.0,M10.5.0/3",
+    "CST5CDT,M3.2.0/0,M11.1.0/1",
+    "CST6CDT,M3.2.0,M11.1.0",
+    "CST6CDT,M4.1.0,M10.5.0",
+    "EET-2EEST,M2.5.4/24,M10.5.5/1",
+    "EET-2EEST,M3.4.4/48,M10.5.5/1",
+    "EET-2EEST,M3.5.0,M10.5.0/3",
+    "EET-2EEST,M3.5.0/0,M10.5.0/0",
+    "EET-2EEST,M3.5.0/3,M10.5.0/4",
+    "EET-2EEST,M3.5.5/0,M10.5.5/0",
+    "EST5EDT,M3.2.0,M11.1.0",
+    "GMT0BST,M3.5.0/1,M10.5.0",
+    "HST10HDT,M3.2.0,M11.1.0",
+    "IST-1GMT0,M10.5.0,M3.5.0/1",
+    "IST-2IDT,M3.4.4/26,M10.5.0",
+    "MST7MDT,M3.2.0,M11.1.0",
+    "MST7MDT,M4.1.0,M10.5.0",
+    "NST3:30NDT,M3.2.0,M11.1.0",
+    "NZST-12NZDT,M9.5.0,M4.1.0/3",
+    "PST8PDT,M3.2.0,M11.1.0",
+    "WET0WEST,M3.5.0/1,M10.5.0",
+    "JST-9",
+    "<+0545>-5:45",
+    "<-0930>9:30",
+    "UTC0",
+    "EST5EDT",
+};
+
+// 2020-01-01 and 2031-01-01
+static const time_t FROM = 1577836800;
+static const time_t TO = 1924992000;
+
+static long libcOffset(time_t utc) {
+  struct tm local;
+  localtime_r(&utc, &local);
+  return local.tm_gmtoff;
+}
+
+static void useLibcTz(const char *tz) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+void test_parse() {
+  PosixTz tz;
+  TEST_ASSERT_TRUE(tz.parse("NST3:30NDT,M3.2.0,M11.1.0"));
+  TEST_ASSERT_TRUE(tz.hasDst());
+  TEST_ASSERT_EQUAL(-(3 * HOUR + 30 * 60), tz.offset(FROM));
+  TEST_ASSERT_TRUE(tz.parse("<+0545>-5:45"));
+  TEST_ASSERT_FALSE(tz.hasDst());
+  TEST_ASSERT_EQUAL(5 * HOUR + 45 * 60, tz.offset(FROM));
+  TEST_ASSERT_TRUE(tz.parse("UTC"));
+  TEST_ASSERT_EQUAL(0, tz.offset(FROM));
+
+  const char *invalid[] = {
+      "",
+      "E",
+      "EST5EDT,",
+      "EST5EDT,M3.2.0",
+      "EST5EDT,M13.2.0,M11.1.0",
+      "EST5EDT,M3.6.0,M11.1.0",
+      "EST5EDT,M3.2.7,M11.1.0",
+      "EST5EDT,M3.2.0/168,M11.1.0",
+      "EST5EDT,J0,J365",
+      "<+05-5",
+      "EST5EDT!",
+      "EST25",
+      NULL,
+  };
+  for (const char *s : invalid) {
+    tz.parse("JST-9");
+    TEST_ASSERT_FALSE_MESSAGE(tz.parse(s), s ? s : "NULL");
+    // Left as it was
+    TEST_ASSERT_EQUAL(9 * HOUR, tz.offset(FROM));
+  }
+}
+
+// Hourly over a decade, plus either side of every change, against glibc
+void test_offsets_match_libc() {
+  char msg[96];
+  for (const char *zone : ZONES) {
+    PosixTz tz;
+    TEST_ASSERT_TRUE_MESSAGE(tz.parse(zone), zone);
+    useLibcTz(zone);
+
+    for (time_t t = FROM; t < TO; t += HOUR) {
+      if (tz.offset(t) != libcOffset(t)) {
+        snprintf(msg, sizeof(msg), "%s at %lld", zone, (long long)t);
+        TEST_FAIL_MESSAGE(msg);
+      }
+    }
+
+    int changes = 0;
+    for (time_t t = tz.nextChange(FROM); t != 0 && t < TO; t = tz.nextChange(t)) {
+      snprintf(msg, sizeof(msg), "%s change at %lld", zone, (long long)t);
+      TEST_ASSERT_EQUAL_MESSAGE(libcOffset(t - 1), tz.offset(t - 1), msg);
+      TEST_ASSERT_EQUAL_MESSAGE(libcOffset(t), tz.offset(t), msg);
+      TEST_ASSERT_TRUE_MESSAGE(tz.offset(t - 1) != tz.offset(t), msg);
+      changes++;
+    }
+    if (tz.hasDst()) {
+      TEST_ASSERT_EQUAL_MESSAGE(2 * 11, changes, zone);
+    }
+  }
+  unsetenv("TZ");
+  tzset();
+}
+
+// Wall clock midnight of a date, counted as if local were UTC
+static int64_t localDay(int year, int month, int day) {
+  struct tm date = {};
+  date.tm_year = year - 1900;
+  date.tm_mon = month - 1;
+  date.tm_mday = day;
+  return timegm(&date);
+}
+
+void test_to_utc_spring_forward() {
+  PosixTz tz;
+  TEST_ASSERT_TRUE(tz.parse("EST5EDT,M3.2.0,M11.1.0"));
+  // 2024-03-10 02:00 EST, 07:00 UTC, the clocks jump to 03:00 EDT
+  int64_t day = localDay(2024, 3, 10);
+  time_t change = localDay(2024, 3, 10) + 7 * HOUR;
+  TEST_ASSERT_EQUAL(change, tz.nextChange(change - 1));
+
+  TEST_ASSERT_EQUAL(change - 30 * 60, tz.toUtc(day + 90 * 60));
+  TEST_ASSERT_EQUAL(change - 1, tz.toUtc(day + 2 * HOUR - 1));
+  // Nothing happens from 02:00 to 02:59 so it all happens at the change
+  TEST_ASSERT_EQUAL(change, tz.toUtc(day + 2 * HOUR));
+  TEST_ASSERT_EQUAL(change, tz.toUtc(day + 150 * 60));
+  TEST_ASSERT_EQUAL(change, tz.toUtc(day + 3 * HOUR - 1));
+  TEST_ASSERT_EQUAL(change, tz.toUtc(day + 3 * HOUR));
+  TEST_ASSERT_EQUAL(change + 30 * 60, tz.toUtc(day + 210 * 60));
+}
+
+void test_to_utc_fall_back() {
+  PosixTz tz;
+  TEST_ASSERT_TRUE(tz.parse("EST5EDT,M3.2.0,M11.1.0"));
+  // 2024-11-03 02:00 EDT, 06:00 UTC, the clocks go back to 01:00 EST
+  int64_t day = localDay(2024, 11, 3);
+  time_t change = localDay(2024, 11, 3) + 6 * HOUR;
+  TEST_ASSERT_EQUAL(change, tz.nextChange(change - 1));
+
+  // 01:00 to 01:59 happen twice, and count from the first time
+  TEST_ASSERT_EQUAL(change - HOUR, tz.toUtc(day + HOUR));
+  TEST_ASSERT_EQUAL(change - 30 * 60, tz.toUtc(day + 90 * 60));
+  TEST_ASSERT_EQUAL(change - 1, tz.toUtc(day + 2 * HOUR - 1));
+  TEST_ASSERT_EQUAL(change + HOUR, tz.toUtc(day + 2 * HOUR));
+}
+
+void test_to_utc_southern() {
+  PosixTz tz;
+  // Lord Howe Island only moves its clocks by half an hour
+  TEST_ASSERT_TRUE(tz.parse("<+1030>-10:30<+11>-11,M10.1.0,M4.1.0"));
+
+  // 2024-10-06 02:00 +1030 jumps to 02:30 +11
+  int64_t day = localDay(2024, 10, 6);
+  time_t change = day + 2 * HOUR - (10 * HOUR + 30 * 60);
+  TEST_ASSERT_EQUAL(change, tz.toUtc(day + 2 * HOUR + 15 * 60));
+  TEST_ASSERT_EQUAL(change + 30 * 60, tz.toUtc(day + 3 * HOUR));
+
+  // 2025-04-06 02:00 +11 goes back to 01:30 +1030, so 01:30 to 01:59 repeat
+  day = localDay(2025, 4, 6);
+  change = day + 2 * HOUR - 11 * HOUR;
+  TEST_ASSERT_EQUAL(change - 15 * 60, tz.toUtc(day + 105 * 60));
+  TEST_ASSERT_EQUAL(change + 45 * 60, tz.toUtc(day + 2 * HOUR + 15 * 60));
+}
+
+// Every wall clock time that happens maps back to when it happened, or to an
+// earlier time with the same reading if the clocks went back in between
+void test_to_utc_round_trip() {
+  char msg[96];
+  for (const char *zone : ZONES) {
+    PosixTz tz;
+    TEST_ASSERT_TRUE(tz.parse(zone));
+    for (time_t t = FROM; t < FROM + 2 * 365 * DAY; t += 15 * 60) {
+      time_t local = t + tz.offset(t);
+      time_t utc = tz.toUtc(local);
+      if (utc != t && !(utc < t && utc + tz.offset(utc) == local)) {
+        snprintf(msg, sizeof(msg), "%s at %lld gave %lld", zone, (long long)t, (long long)utc);
+        TEST_FAIL_MESSAGE(msg);
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_parse);
+  RUN_TEST(test_offsets_match_libc);
+  RUN_TEST(test_to_utc_spring_forward);
+  RUN_TEST(test_to_utc_fall_back);
+  RUN_TEST(test_to_utc_southern);
+  RUN_TEST(test_to_utc_round_trip);
+  UNITY_END();
+
+  return 0;
+}
@@ -0,0 +1,296 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unity.h>
+
+#include "TzResponse.h"
+
+#define SUCCESS_BODY "success,America/New_York\n"
+
+typedef TzResponseParser::Result Result;
+
+void test_split_anywhere() {
+  const char body[] = "success,Europe/London\r\n";
+  const size_t size = sizeof(body) - 1;
+  char msg[32];
+
+  for (size_t i = 0; i <= size; i++) {
+    for (size_t j = i; j <= size; j++) {
+      TzResponseParser parser;
+      parser.feed(body, i);
+      parser.feed(body + i, j - i);
+      parser.feed(body + j, size - j);
+      snprintf(msg, sizeof(msg), "split %zu/%zu", i, j);
+      TEST_ASSERT_EQUAL_MESSAGE(Result::SUCCESS, parser.finish(), msg);
+      TEST_ASSERT_EQUAL_STRING_MESSAGE("Europe/London", parser.value(), msg);
+    }
+  }
+}
+
+static Result parse(const std::string &body, TzResponseParser &parser) {
+  parser.reset();
+  parser.feed(body.data(), body.size());
+  return parser.finish();
+}
+
+void test_responses() {
+  TzResponseParser parser;
+
+  TEST_ASSERT_EQUAL(Result::SUCCESS, parse("success,Asia/Tokyo", parser));
+  TEST_ASSERT_EQUAL_STRING("Asia/Tokyo", parser.value());
+
+  TEST_ASSERT_EQUAL(Result::FAILURE, parse("fail,private range\n", parser));
+  TEST_ASSERT_EQUAL_STRING("private range", parser.value());
+
+  // Long messages are cut short rather than rejected
+  TEST_ASSERT_EQUAL(Result::FAILURE, parse("fail," + std::string(200, 'x') + "\n", parser));
+  TEST_ASSERT_EQUAL(TZ_RESPONSE_VALUE_SIZE - 1, strlen(parser.value()));
+
+  // Only the first line counts
+  TEST_ASSERT_EQUAL(Result::SUCCESS, parse("success,UTC\nfail,oops\n", parser));
+  TEST_ASSERT_EQUAL_STRING("UTC", parser.value());
+}
+
+void test_invalid_responses() {
+  TzResponseParser parser;
+
+  TEST_ASSERT_EQUAL(Result::INVALID, parse("", parser));
+  TEST_ASSERT_EQUAL(Result::INVALID, parse("success", parser));
+  TEST_ASSERT_EQUAL(Result::INVALID, parse("success,\n", parser));
+  TEST_ASSERT_EQUAL(Result::INVALID, parse("successful,UTC\n", parser));
+  TEST_ASSERT_EQUAL(Result::INVALID, parse("<html><body>502 Bad Gateway</body></html>", parser));
+  // Too long to be a zone, and truncating it would look up the wrong one
+  TEST_ASSERT_EQUAL(Result::INVALID, parse("success," + std::string(100, 'A') + "\n", parser));
+}
+
+void test_bounded_memory() {
+  // The whole response state, however large the response
+  TEST_ASSERT_TRUE(sizeof(TzResponseParser) <= 64);
+}
+
+// A stand-in for the provider, serving one canned response from a child
+// process. The body is given in pieces, which are sent as separate chunks when
+// `chunked`, and everything is dripped out a byte at a time when `delay_us` is
+// non-zero.
+struct MockResponse {
+  int status;
+  bool chunked;
+  useconds_t delay_us;
+  std::string pieces[4];
+};
+
+static void send_all(int fd, const std::string &data, useconds_t delay_us) {
+  if (delay_us == 0) {
+    write(fd, data.data(), data.size());
+    return;
+  }
+  for (char c : data) {
+    write(fd, &c, 1);
+    usleep(delay_us);
+  }
+}
+
+static void serve(int listener, const MockResponse &response) {
+  signal(SIGPIPE, SIG_IGN);
+  int fd = accept(listener, NULL, NULL);
+  std::string request;
+  char buf[256];
+  while (request.find("\r\n\r\n") == std::string::npos) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      _exit(1);
+    }
+    request.append(buf, n);
+  }
+
+  std::string body;
+  for (const std::string &piece : response.pieces) {
+    body += piece;
+  }
+  std::string head = "HTTP/1.1 " + std::to_string(response.status) + " OK\r\n";
+  head += "Content-Type: text/plain\r\nConnection: close\r\n";
+  if (response.chunked) {
+    head += "Transfer-Encoding: chunked\r\n\r\n";
+  } else {
+    head += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+  }
+  send_all(fd, head, response.delay_us);
+
+  for (const std::string &piece : response.pieces) {
+    if (piece.empty()) {
+      continue;
+    }
+    if (response.chunked) {
+      char size[24];
+      snprintf(size, sizeof(size), "%zx\r\n", piece.size());
+      send_all(fd, size + piece + "\r\n", response.delay_us);
+    } else {
+      send_all(fd, piece, response.delay_us);
+    }
+  }
+  if (response.chunked) {
+    send_all(fd, "0\r\n\r\n", response.delay_us);
+  }
+  close(fd);
+  _exit(0);
+}
+
+static int start_server(const MockResponse &response, pid_t *pid) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  TEST_ASSERT_TRUE(listener >= 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t addr_size = sizeof(addr);
+  TEST_ASSERT_EQUAL(0, bind(listener, (sockaddr *)&addr, sizeof(addr)));
+  TEST_ASSERT_EQUAL(0, listen(listener, 1));
+  TEST_ASSERT_EQUAL(0, getsockname(listener, (sockaddr *)&addr, &addr_size));
+
+  *pid = fork();
+  TEST_ASSERT_TRUE(*pid >= 0);
+  if (*pid == 0) {
+    serve(listener, response);
+  }
+  close(listener);
+  return ntohs(addr.sin_port);
+}
+
+// Undoes chunked transfer encoding in place, as esp_http_client does before
+// HTTP_EVENT_ON_DATA, handing each run of body bytes straight to the parser.
+struct Dechunker {
+  enum { SIZE, DATA, DATA_END, DONE } state = SIZE;
+  size_t remaining = 0;
+
+  void feed(const char *data, size_t size, TzResponseParser &parser) {
+    size_t i = 0;
+    while (i < size && state != DONE) {
+      if (state == SIZE) {
+        char c = data[i++];
+        if (c == '\n') {
+          state = remaining > 0 ? DATA : DONE;
+        } else if (c != '\r') {
+          remaining = remaining * 16 + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+        }
+      } else if (state == DATA) {
+        size_t n = remaining < size - i ? remaining : size - i;
+        parser.feed(data + i, n);
+        i += n;
+        remaining -= n;
+        if (remaining == 0) {
+          state = DATA_END;
+        }
+      } else if (data[i++] == '\n') {
+        state = SIZE;
+      }
+    }
+  }
+};
+
+// Fetches from the mock server with small reads so the body arrives split
+// wherever the socket happens to split it. Returns the HTTP status.
+static int fetch(const MockResponse &response, TzResponseParser &parser) {
+  pid_t pid;
+  int port = start_server(response, &pid);
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  TEST_ASSERT_EQUAL(0, connect(fd, (sockaddr *)&addr, sizeof(addr)));
+  const char request[] = "GET /csv?fields=status,message,timezone HTTP/1.1\r\n"
+                         "Host: localhost\r\nConnection: close\r\n\r\n";
+  write(fd, request, sizeof(request) - 1);
+
+  parser.reset();
+  std::string head;
+  bool in_body = false;
+  bool chunked = false;
+  Dechunker dechunker;
+  char buf[16];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    const char *data = buf;
+    size_t size = n;
+    if (!in_body) {
+      // Headers are small, so buffering those is fine
+      head.append(buf, n);
+      size_t end = head.find("\r\n\r\n");
+      if (end == std::string::npos) {
+        continue;
+      }
+      in_body = true;
+      chunked = head.find("Transfer-Encoding: chunked") != std::string::npos;
+      size_t body_in_buf = head.size() - (end + 4);
+      data = buf + n - body_in_buf;
+      size = body_in_buf;
+    }
+    if (chunked) {
+      dechunker.feed(data, size, parser);
+    } else {
+      parser.feed(data, size);
+    }
+  }
+  close(fd);
+
+  int status;
+  waitpid(pid, &status, 0);
+  TEST_ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  return atoi(head.c_str() + strlen("HTTP/1.1 "));
+}
+
+void test_server_content_length() {
+  TzResponseParser parser;
+  MockResponse response{200, false, 0, {SUCCESS_BODY}};
+  TEST_ASSERT_EQUAL(200, fetch(response, parser));
+  TEST_ASSERT_EQUAL(Result::SUCCESS, parser.finish());
+  TEST_ASSERT_EQUAL_STRING("America/New_York", parser.value());
+}
+
+void test_server_chunked() {
+  TzResponseParser parser;
+  MockResponse response{200, true, 0, {"succ", "ess,Amer", "ica/New_Yo", "rk\n"}};
+  TEST_ASSERT_EQUAL(200, fetch(response, parser));
+  TEST_ASSERT_EQUAL(Result::SUCCESS, parser.finish());
+  TEST_ASSERT_EQUAL_STRING("America/New_York", parser.value());
+}
+
+void test_server_slow_chunked() {
+  TzResponseParser parser;
+  // A byte every 2ms, so nearly every read returns a single byte
+  MockResponse response{200, true, 2000, {"success,", "Australia/Lord_Howe", "\n"}};
+  TEST_ASSERT_EQUAL(200, fetch(response, parser));
+  TEST_ASSERT_EQUAL(Result::SUCCESS, parser.finish());
+  TEST_ASSERT_EQUAL_STRING("Australia/Lord_Howe", parser.value());
+}
+
+void test_server_large_error_page() {
+  TzResponseParser parser;
+  std::string page = "<html><body>" + std::string(8192, '.') + "</body></html>";
+  MockResponse response{503, true, 0, {page.substr(0, 4000), page.substr(4000)}};
+  TEST_ASSERT_EQUAL(503, fetch(response, parser));
+  TEST_ASSERT_EQUAL(Result::INVALID, parser.finish());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_split_anywhere);
+  RUN_TEST(test_responses);
+  RUN_TEST(test_invalid_responses);
+  RUN_TEST(test_bounded_memory);
+  RUN_TEST(test_server_content_length);
+  RUN_TEST(test_server_chunked);
+  RUN_TEST(test_server_slow_chunked);
+  RUN_TEST(test_server_large_error_page);
+  UNITY_END();
+
+  return 0;
+}
@@ -1,12 +1,15 @@
-#include "zones.h"
+#pragma once
+
+// The sorted table and binary search that zones.c used before it was
+// generated, kept to check the generated table against.
 #include <stdio.h>
 
 typedef struct {
   const char *name;
   const char *posix_str;
-} micro_tz_db_pair;
+} legacy_pair;
 
-static const micro_tz_db_pair micro_tz_db_tzs[425] = {
+static const legacy_pair legacy_tzs[425] = {
   {"Africa/Abidjan", "GMT0"},
   {"Africa/Accra", "GMT0"},
   {"Africa/Addis_Ababa", "EAT-3"},
@@ -470,11 +473,11 @@ static int tz_name_cmp(const char * target, const char * other) {
   return lower(*target) - lower(*other);
 }
 
-const char *micro_tz_db_get_posix_str(const char *name) {
-  int lo = 0, hi = sizeof(micro_tz_db_tzs) / sizeof(micro_tz_db_pair);
+static const char *legacy_get_posix_str(const char *name) {
+  int lo = 0, hi = sizeof(legacy_tzs) / sizeof(legacy_pair);
   while (lo < hi) {
     int mid = (lo + hi) / 2;
-    micro_tz_db_pair mid_pair = micro_tz_db_tzs[mid];
+    legacy_pair mid_pair = legacy_tzs[mid];
     int comparison = tz_name_cmp(name, mid_pair.name);
     if (comparison == 0) {
       return mid_pair.posix_str;
@@ -0,0 +1,113 @@
+#include <chrono>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+
+#include "legacy_zones.h"
+#include "zones.h"
+
+#define ZONE_COUNT (sizeof(legacy_tzs) / sizeof(legacy_tzs[0]))
+
+// Both lookups must agree, including on which names aren't found
+static void assert_same(const std::string &name) {
+  const char *expected = legacy_get_posix_str(name.c_str());
+  const char *actual = micro_tz_db_get_posix_str(name.c_str());
+  if (expected == NULL) {
+    TEST_ASSERT_NULL_MESSAGE(actual, name.c_str());
+  } else {
+    TEST_ASSERT_NOT_NULL_MESSAGE(actual, name.c_str());
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(expected, actual, name.c_str());
+  }
+}
+
+void test_every_zone() {
+  for (size_t i = 0; i < ZONE_COUNT; i++) {
+    TEST_ASSERT_EQUAL_STRING(legacy_tzs[i].posix_str,
+                             micro_tz_db_get_posix_str(legacy_tzs[i].name));
+  }
+}
+
+void test_name_variants() {
+  for (size_t i = 0; i < ZONE_COUNT; i++) {
+    std::string name = legacy_tzs[i].name;
+
+    std::string upper = name;
+    for (char &c : upper) {
+      c = toupper(c);
+    }
+    assert_same(upper);
+
+    std::string no_underscores;
+    std::string spaced;
+    std::string doubled;
+    for (char c : name) {
+      if (c != '_') {
+        no_underscores += c;
+      }
+      spaced += c == '_' ? ' ' : c;
+      doubled += c == '_' ? "__" : std::string(1, c);
+    }
+    assert_same(no_underscores);
+    assert_same(spaced);
+    assert_same(doubled);
+    assert_same(name + "_");
+    assert_same("_" + name);
+  }
+}
+
+void test_unknown_names() {
+  TEST_ASSERT_NULL(micro_tz_db_get_posix_str(NULL));
+  TEST_ASSERT_NULL(micro_tz_db_get_posix_str(""));
+  assert_same("Etc/Nowhere");
+  assert_same("America");
+
+  // Every prefix of every name, and every name with a character added, which
+  // covers near misses in both directions
+  for (size_t i = 0; i < ZONE_COUNT; i++) {
+    std::string name = legacy_tzs[i].name;
+    for (size_t length = 1; length < name.size(); length++) {
+      assert_same(name.substr(0, length));
+    }
+    for (char c = ' '; c <= '~'; c++) {
+      assert_same(name + c);
+    }
+  }
+}
+
+template <typename Lookup> static double ns_per_lookup(Lookup lookup, size_t *sink) {
+  const int rounds = 2000;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < ZONE_COUNT; i++) {
+      *sink += (size_t)lookup(legacy_tzs[i].name);
+    }
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  return (double)ns / rounds / ZONE_COUNT;
+}
+
+void bench_lookup() {
+  char msg[80];
+  size_t sink = 0;
+  double legacy = ns_per_lookup(&legacy_get_posix_str, &sink);
+  double hashed = ns_per_lookup(&micro_tz_db_get_posix_str, &sink);
+
+  snprintf(msg, sizeof(msg), "lookup: binary search %5.1f ns, perfect hash %5.1f ns (%zu)", legacy,
+           hashed, sink % 10);
+  TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_zone);
+  RUN_TEST(test_name_variants);
+  RUN_TEST(test_unknown_names);
+  RUN_TEST(bench_lookup);
+  UNITY_END();
+
+  return 0;
+}